@@ -17,6 +17,7 @@
 
 #include "multio/LibMultio.h"
 #include "multio/domain/Mappings.h"
+#include "multio/message/BufferPool.h"
 #include "multio/util/ScopedTimer.h"
 
 namespace multio {
@@ -28,7 +29,10 @@ Aggregation::Aggregation(const eckit::Configuration& config) : Action(config) {}
 
 void Aggregation::execute(Message msg) const {
     if ((msg.tag() == Message::Tag::Field) && handleField(msg)) {
-        executeNext(createGlobalField(msg));
+        auto it = fields_.find(msg.fieldKey());
+        auto global = std::move(it->second.msg);
+        fields_.erase(it);
+        executeNext(std::move(global));
     }
 
     if ((msg.tag() == Message::Tag::StepComplete) && handleFlush(msg)) {
@@ -38,7 +42,15 @@ void Aggregation::execute(Message msg) const {
 
 bool Aggregation::handleField(const Message& msg) const {
     eckit::AutoTiming timing{statistics_.timer_, statistics_.actionTiming_};
-    messages_[msg.fieldId()].push_back(msg);
+    auto it = fields_.find(msg.fieldKey());
+    if (it == end(fields_)) {
+        it = fields_.emplace(msg.fieldKey(), GlobalField{createGlobalField(msg), 0}).first;
+    }
+
+    // The part is released by the caller as soon as it has been scattered
+    domain::Mappings::instance().get(msg.domain()).at(msg.source())->to_global(msg, it->second.msg);
+    ++it->second.parts;
+
     return allPartsArrived(msg);
 }
 
@@ -49,43 +61,35 @@ bool Aggregation::handleFlush(const Message& msg) const {
         flushes_[msg.domain()] = 0;
     }
 
-    return ++flushes_.at(msg.domain()) == msg.domainCount();
+    // A gathered step completion stands for the flushes of all the clients it was gathered from
+    flushes_.at(msg.domain()) += msg.metadata().getLong("flushCount", 1);
+    return flushes_.at(msg.domain()) == msg.domainCount();
 }
 
 bool Aggregation::allPartsArrived(const Message& msg) const {
-  LOG_DEBUG_LIB(LibMultio) << " *** Number of messages for field " << msg.fieldId()
-                           << " are " << messages_.at(msg.fieldId()).size() << std::endl;
+  LOG_DEBUG_LIB(LibMultio) << " *** Number of messages for field " << msg.fieldKey()
+                           << " are " << fields_.at(msg.fieldKey()).parts << std::endl;
 
-  return (msg.domainCount() == messages_.at(msg.fieldId()).size()) &&
+  return (msg.domainCount() == fields_.at(msg.fieldKey()).parts) &&
          (msg.domainCount() == domain::Mappings::instance().get(msg.domain()).size());
 }
 
 Message Aggregation::createGlobalField(const Message& msg) const {
-    eckit::AutoTiming timing{statistics_.timer_, statistics_.actionTiming_};
-
-    const auto& fid = msg.fieldId();
-    LOG_DEBUG_LIB(LibMultio) << " *** Creating global field for " << fid << std::endl;
+    const auto key = msg.fieldKey();
+    LOG_DEBUG_LIB(LibMultio) << " *** Creating global field for " << key << std::endl;
 
     auto levelCount = msg.metadata().getLong("levelCount", 1);
 
     auto md = msg.header().metadata();
-    Message msgOut{
-        Message::Header{msg.header().tag(), Peer{}, Peer{}, std::move(md)},
-        eckit::Buffer{msg.globalSize() * levelCount * sizeof(double)}};
-
-    for (const auto& msg : messages_.at(fid)) {
-        domain::Mappings::instance().get(msg.domain()).at(msg.source())->to_global(msg, msgOut);
-    }
-
-    messages_.erase(fid);
-
-    return msgOut;
+    return Message{
+        Message::Header{msg.header().tag(), Peer{}, Peer{}, std::move(md), key},
+        message::BufferPool::instance().allocate(msg.globalSize() * levelCount * sizeof(double))};
 }
 
 void Aggregation::print(std::ostream& os) const {
-    os << "Aggregation(for " << messages_.size() << " fields = [";
-    for (const auto& msg : messages_) {
-        os << '\n' << "  --->  " << msg.first;
+    os << "Aggregation(for " << fields_.size() << " fields = [";
+    for (const auto& field : fields_) {
+        os << '\n' << "  --->  " << field.first << " (" << field.second.parts << " parts)";
     }
     os << "])";
 }
@@ -18,6 +18,7 @@
 #define multio_server_actions_Aggregation_H
 
 #include <iosfwd>
+#include <map>
 #include <unordered_map>
 #include <vector>
 
@@ -47,7 +48,13 @@ private:
     Message createGlobalField(const Message& msg) const;
     bool allPartsArrived(const Message& msg) const;
 
-    mutable std::map<std::string, std::vector<Message>> messages_;
+    // Parts are scattered into the global field as they arrive, so only the latter is kept
+    struct GlobalField {
+        Message msg;
+        size_t parts;
+    };
+
+    mutable std::unordered_map<message::FieldKey, GlobalField> fields_;
     mutable std::map<std::string, unsigned int> flushes_;
 };
 
@@ -12,6 +12,7 @@
 
 #include <iostream>
 
+#include "eckit/config/Configuration.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/io/StdFile.h"
 
@@ -48,7 +49,10 @@ using message::Message;
 using message::Peer;
 
 Encode::Encode(const eckit::Configuration& config) :
-    Action{config}, format_{config.getString("format")}, encoder_{make_encoder(config)} {}
+    Action{config},
+    format_{config.getString("format")},
+    sharedGrids_{config.getUnsigned("dispatcherThreads", 1) > 1},
+    encoder_{make_encoder(config)} {}
 
 void Encode::execute(Message msg) const {
     if (not encoder_) {
@@ -61,29 +65,32 @@ void Encode::execute(Message msg) const {
     LOG_DEBUG_LIB(LibMultio) << " *** Looking for grid info for subtype: " << msg.domain()
                              << std::endl;
 
-    if (encoder_->gridInfoReady(msg.domain())) {
-        auto levelCount = msg.metadata().getLong("levelCount", 1);
-        ASSERT(levelCount == 1);
-        // TODO: most of this can probably go if we stick to levelCount == 1 always
-        if (levelCount == 1) {
-            executeNext(encoder_->encodeField(msg));
-        }
-        else {
-            auto metadata = msg.metadata();
-            auto data = reinterpret_cast<const double*>(msg.payload().data());
-            for (auto lev = 0; lev != levelCount;) {
-                metadata.set("level", ++lev);
-                executeNext(encoder_->encodeField(metadata, data, msg.globalSize()));
-                data += msg.globalSize();
-            }
-        }
-    }
-    else {
+    if (not encoder_->gridInfoReady(msg.domain()) && encoder_->isGridCoordinate(msg)) {
         LOG_DEBUG_LIB(LibMultio) << "*** Grid metadata: " << msg.metadata() << std::endl;
         if (encoder_->setGridInfo(msg)) {
             executeNext(encodeLatitudes(msg.domain()));
             executeNext(encodeLongitudes(msg.domain()));
         }
+        return;
+    }
+
+    // With several dispatcher workers, the coordinates may still be handled by another one
+    encoder_->waitForGridInfo(msg.domain(), sharedGrids_);
+
+    auto levelCount = msg.metadata().getLong("levelCount", 1);
+    ASSERT(levelCount == 1);
+    // TODO: most of this can probably go if we stick to levelCount == 1 always
+    if (levelCount == 1) {
+        executeNext(encoder_->encodeField(msg));
+    }
+    else {
+        auto metadata = msg.metadata();
+        auto data = reinterpret_cast<const double*>(msg.payload().data());
+        for (auto lev = 0; lev != levelCount;) {
+            metadata.set("level", ++lev);
+            executeNext(encoder_->encodeField(metadata, data, msg.globalSize()));
+            data += msg.globalSize();
+        }
     }
 }
 
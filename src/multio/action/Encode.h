@@ -42,6 +42,9 @@ private:
 
     const std::string format_;
 
+    // Whether other dispatcher workers may set the grid coordinates this encoder waits for
+    const bool sharedGrids_;
+
     const std::unique_ptr<GribEncoder> encoder_ = nullptr;
 };
 
@@ -14,14 +14,20 @@
 
 #include "GribEncoder.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
 #include "eckit/exception/Exceptions.h"
 #include "eckit/log/Log.h"
 #include "multio/LibMultio.h"
 #include "multio/action/GridInfo.h"
+#include "multio/message/BufferPool.h"
 
 
 namespace multio {
@@ -32,11 +38,43 @@ using message::Peer;
 
 namespace  {
 // TODO: perhaps move this to Mappings as that is already a singleton
-std::map<std::string, std::unique_ptr<GridInfo>>& grids() {
-    static std::map<std::string, std::unique_ptr<GridInfo>> grids_;
+// Shared by the encoders of all dispatcher workers. The subtypes are fixed when the grids are first
+// used, so the maps never change shape. Grid infos are filled in under the lock and do not change
+// once their hash has been computed, which `complete` publishes so that they can be read without
+// the lock from then on.
+const std::vector<std::string> gridSubtypes{"T grid", "U grid", "V grid", "W grid", "F grid"};
+
+struct Grids {
+    Grids() {
+        for (const auto& subtype : gridSubtypes) {
+            infos.insert(std::make_pair(subtype, std::unique_ptr<GridInfo>{new GridInfo{}}));
+            complete[subtype].store(false);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::map<std::string, std::unique_ptr<GridInfo>> infos;
+    std::map<std::string, std::atomic<bool>> complete;
+};
+
+Grids& grids() {
+    static Grids grids_;
     return grids_;
 }
 
+bool grid_complete(const std::string& subtype) {
+    return grids().complete.at(subtype).load(std::memory_order_acquire);
+}
+
+GridInfo& grid_info(const std::string& subtype) {
+    ASSERT(grid_complete(subtype));
+    return *grids().infos.at(subtype);
+}
+
+// Coordinates normally arrive first; anything else missing them after this long is an error
+const std::chrono::seconds gridInfoTimeout{60};
+
 const std::map<const std::string, const long> ops_to_code{
     {"average", 0}, {"accumulate", 1}, {"maximum", 2}, {"minimum", 3}, {"stddev", 6}};
 
@@ -46,32 +84,58 @@ const std::map<const std::string, const long> category_to_levtype{
 }  // namespace
 
 GribEncoder::GribEncoder(codes_handle* handle, const std::string& gridType) :
-    metkit::grib::GribHandle{handle}, gridType_{gridType} {
-    for (auto const& subtype : {"T grid", "U grid", "V grid", "W grid", "F grid"}) {
-        grids().insert(std::make_pair(subtype, std::unique_ptr<GridInfo>{new GridInfo{}}));
-    }
-}
+    metkit::grib::GribHandle{handle}, gridType_{gridType} {}
 
 bool GribEncoder::gridInfoReady(const std::string& subtype) const {
-    return grids().at(subtype)->hashExists();
+    return grid_complete(subtype);
+}
+
+bool GribEncoder::isGridCoordinate(const message::Message& msg) const {
+    return msg.metadata().has("nemoParam") &&
+           coordSet_.find(msg.metadata().getString("nemoParam")) != end(coordSet_);
+}
+
+void GribEncoder::waitForGridInfo(const std::string& subtype, bool wait) const {
+    if (grid_complete(subtype)) {
+        return;
+    }
+
+    if (not wait) {
+        throw eckit::SeriousBug("Grid coordinates for " + subtype + " have not arrived", Here());
+    }
+
+    std::unique_lock<std::mutex> lock{grids().mutex};
+    if (not grids().ready.wait_for(lock, gridInfoTimeout,
+                                   [&subtype]() { return grid_complete(subtype); })) {
+        throw eckit::SeriousBug("Grid coordinates for " + subtype + " have not arrived", Here());
+    }
 }
 
 bool GribEncoder::setGridInfo(message::Message msg) {
-    ASSERT(not gridInfoReady(msg.domain())); // Panic check during development
+    ASSERT(isGridCoordinate(msg));
+
+    std::lock_guard<std::mutex> lock{grids().mutex};
+    auto& info = *grids().infos.at(msg.domain());
 
-    ASSERT(coordSet_.find(msg.metadata().getString("nemoParam")) != end(coordSet_));
+    ASSERT(not info.hashExists()); // Panic check during development
 
-    grids().at(msg.domain())->setSubtype(msg.domain());
+    info.setSubtype(msg.domain());
 
     if (msg.metadata().getString("nemoParam").substr(0, 3) == "lat") {
-        grids().at(msg.domain())->setLatitudes(msg);
+        info.setLatitudes(msg);
     }
 
     if (msg.metadata().getString("nemoParam").substr(0, 3) == "lon") {
-        grids().at(msg.domain())->setLongitudes(msg);
+        info.setLongitudes(msg);
+    }
+
+    if (not info.computeHashIfCan()) {
+        return false;
     }
 
-    return grids().at(msg.domain())->computeHashIfCan();
+    grids().complete.at(msg.domain()).store(true, std::memory_order_release);
+    grids().ready.notify_all();
+    return true;
 }
 
 void GribEncoder::setOceanMetadata(const message::Metadata& metadata) {
@@ -114,7 +178,7 @@ void GribEncoder::setOceanMetadata(const message::Metadata& metadata) {
     const auto& gridSubtype = metadata.getString("gridSubtype");
     setValue("unstructuredGridSubtype", gridSubtype.substr(0, 1));
 
-    setValue("uuidOfHGrid", grids().at(gridSubtype)->hashValue());
+    setValue("uuidOfHGrid", grid_info(gridSubtype).hashValue());
 }
 
 void GribEncoder::setValue(const std::string& key, long value) {
@@ -146,7 +210,7 @@ void GribEncoder::setValue(const std::string& key, const unsigned char* value) {
 }
 
 message::Message GribEncoder::encodeLatitudes(const std::string& subtype) {
-    auto msg = grids().at(subtype)->latitudes();
+    auto msg = grid_info(subtype).latitudes();
 
     setOceanMetadata(msg.metadata());
 
@@ -154,7 +218,7 @@ message::Message GribEncoder::encodeLatitudes(const std::string& subtype) {
 }
 
 message::Message GribEncoder::encodeLongitudes(const std::string& subtype) {
-    auto msg = grids().at(subtype)->longitudes();
+    auto msg = grid_info(subtype).longitudes();
 
     setOceanMetadata(msg.metadata());
 
@@ -176,8 +240,10 @@ message::Message GribEncoder::setFieldValues(const message::Message& msg) {
     auto beg = reinterpret_cast<const double*>(msg.payload().data());
     this->setDataValues(beg, msg.globalSize());
 
-    eckit::Buffer buf{this->length()};
-    this->write(buf);
+    auto buf = message::BufferPool::instance().allocate(this->length());
+    auto len = buf.size();
+    CODES_CHECK(codes_get_message_copy(raw(), buf.data(), &len), NULL);
+    ASSERT(len == buf.size());
 
     return Message{Message::Header{Message::Tag::Grib, Peer{}, Peer{}}, std::move(buf)};
 }
@@ -185,8 +251,10 @@ message::Message GribEncoder::setFieldValues(const message::Message& msg) {
 message::Message GribEncoder::setFieldValues(const double* values, size_t count) {
     this->setDataValues(values, count);
 
-    eckit::Buffer buf{this->length()};
-    this->write(buf);
+    auto buf = message::BufferPool::instance().allocate(this->length());
+    auto len = buf.size();
+    CODES_CHECK(codes_get_message_copy(raw(), buf.data(), &len), NULL);
+    ASSERT(len == buf.size());
 
     return Message{Message::Header{Message::Tag::Grib, Peer{}, Peer{}}, std::move(buf)};
 }
@@ -28,6 +28,12 @@ public:
     GribEncoder(codes_handle* handle, const std::string& gridType);
 
     bool gridInfoReady(const std::string& subtype) const;
+    bool isGridCoordinate(const message::Message& msg) const;
+
+    // Returns once the coordinates of the grid have been set. With `wait`, blocks until another
+    // encoder sets them; without, throws straight away as nothing else could
+    void waitForGridInfo(const std::string& subtype, bool wait) const;
+
     bool setGridInfo(message::Message msg);
 
     void setValue(const std::string& key, long value);
@@ -29,8 +29,8 @@ namespace action {
 
 namespace  {
 template <typename T>
-eckit::Buffer byteswap(const eckit::Buffer& buf) {
-    eckit::Buffer ret{static_cast<const char*>(buf), buf.size()};  // Create a local copy
+eckit::Buffer byteswap(const message::Payload& buf) {
+    eckit::Buffer ret{static_cast<const char*>(buf.data()), buf.size()};  // Create a local copy
 
     auto ret_ptr = reinterpret_cast<T*>(ret.data());
     auto ret_sz = buf.size() / sizeof(T);
@@ -39,6 +39,13 @@ eckit::Buffer byteswap(const eckit::Buffer& buf) {
 
     return ret;
 }
+// Coordinates are kept for the lifetime of the server, so they must not hold on to a slice of a
+// transport receive buffer
+message::Message keepCopy(const message::Message& msg) {
+    return message::Message{
+        message::Message::Header{msg.header()},
+        eckit::Buffer{static_cast<const char*>(msg.payload().data()), msg.size()}};
+}
 }  // namespace
 
 GridInfo::GridInfo() {}
@@ -54,13 +61,13 @@ void GridInfo::setSubtype(const std::string& subtype) {
 void GridInfo::setLatitudes(message::Message msg) {
     ASSERT(latitudes_.size() == 0);
 
-    latitudes_ = msg;
+    latitudes_ = keepCopy(msg);
 }
 
 void GridInfo::setLongitudes(message::Message msg) {
     ASSERT(longitudes_.size() == 0);
 
-    longitudes_ = msg;
+    longitudes_ = keepCopy(msg);
 }
 
 const message::Message& GridInfo::latitudes() const {
@@ -104,7 +111,7 @@ const unsigned char* GridInfo::hashValue() const {
     return hashValue_.get();
 }
 
-void GridInfo::addToHash(const eckit::Buffer& buf) {
+void GridInfo::addToHash(const message::Payload& buf) {
     if (eckit::system::SystemInfo::isBigEndian()) {
         auto swappedBuf = byteswap<double>(buf);
 
@@ -42,7 +42,7 @@ public:
 
 private:
 
-    void addToHash(const eckit::Buffer& buf);
+    void addToHash(const message::Payload& buf);
 
     message::Message latitudes_;
     message::Message longitudes_;
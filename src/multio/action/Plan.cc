@@ -10,6 +10,7 @@
 
 #include "Plan.h"
 
+#include <algorithm>
 #include <fstream>
 
 #include "eckit/config/Configuration.h"
@@ -42,13 +43,20 @@ LocalConfiguration createActionList(std::vector<LocalConfiguration> actions) {
 }
 
 LocalConfiguration rootConfig(const LocalConfiguration& config) {
-    const auto actions = config.has("actions") ? config.getSubConfigurations("actions")
-                                               : std::vector<LocalConfiguration>{};
+    auto actions = config.has("actions") ? config.getSubConfigurations("actions")
+                                         : std::vector<LocalConfiguration>{};
 
     if (actions.empty()) {
         throw eckit::UserError("Plan config must define at least one action");
     }
 
+    // Set by the dispatcher on the plan, passed on to every action
+    if (config.has("dispatcherThreads")) {
+        for (auto& action : actions) {
+            action.set("dispatcherThreads", config.getUnsigned("dispatcherThreads"));
+        }
+    }
+
     return createActionList(actions);
 }
 
@@ -71,5 +79,32 @@ void Plan::process(message::Message msg) {
     root_->execute(msg);
 }
 
+bool PlanOutline::selects(const message::Metadata& metadata) const {
+    return std::all_of(begin(selections), end(selections),
+                       [&metadata](const FieldSelection& sel) { return sel.matches(metadata); });
+}
+
+std::vector<PlanOutline> plan_outlines(const eckit::Configuration& config) {
+    std::vector<PlanOutline> outlines;
+    if (not config.has("plans")) {
+        return outlines;
+    }
+
+    for (const auto& plan : config.getSubConfigurations("plans")) {
+        PlanOutline outline;
+        for (const auto& action : plan.getSubConfigurations("actions")) {
+            auto type = action.getString("type");
+            if (type == "Select") {
+                outline.selections.emplace_back(action);
+            }
+            if (type == "Statistics") {
+                outline.statisticsCount += action.getStringVector("operations").size();
+            }
+        }
+        outlines.push_back(std::move(outline));
+    }
+    return outlines;
+}
+
 }  // namespace action
 }  // namespace multio
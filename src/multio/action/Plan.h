@@ -18,10 +18,12 @@
 #define multio_server_Plan_H
 
 #include <memory>
+#include <vector>
 
 #include "eckit/log/Statistics.h"
 #include "eckit/memory/NonCopyable.h"
 
+#include "multio/action/Select.h"
 #include "multio/message/Message.h"
 
 namespace eckit {
@@ -48,6 +50,18 @@ private:
     eckit::Timing timing_;
 };
 
+// What the configuration of a plan says about the work it does, without building it: the fields
+// its Select actions let through and how many statistics operations it runs on them
+struct PlanOutline {
+    std::vector<FieldSelection> selections;  // All must match; every field if none
+    size_t statisticsCount = 0;
+
+    bool selects(const message::Metadata& metadata) const;
+};
+
+// One outline for each of the `plans` in `config`, if any
+std::vector<PlanOutline> plan_outlines(const eckit::Configuration& config);
+
 }  // namespace action
 }  // namespace multio
 
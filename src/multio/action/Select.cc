@@ -27,8 +27,35 @@ std::vector<std::string> fetch_items(const std::string& match, const eckit::Conf
 }
 }  // namespace
 
-Select::Select(const eckit::Configuration& config) :
-    Action{config}, match_{config.getString("match")}, items_{fetch_items(match_, config)} {}
+FieldSelection::FieldSelection(const eckit::Configuration& config) :
+    all_{false}, match_{config.getString("match")}, items_{fetch_items(match_, config)} {}
+
+bool FieldSelection::matches(const message::Metadata& metadata) const {
+    if (all_) {
+        return true;
+    }
+
+    auto key = (match_ == "category") ? message::Metadata::Key::category
+                                      : message::Metadata::Key::name;
+    if (not metadata.has(key)) {
+        return false;
+    }
+
+    const auto& item = metadata.getString(key);
+    return find(begin(items_), end(items_), item) != end(items_);
+}
+
+void FieldSelection::print(std::ostream& os) const {
+    os << "categories=";
+    bool first = true;
+    for(const auto& cat : items_) {
+        os << (first ? "" : ", ");
+        os << cat;
+        first = false;
+    }
+}
+
+Select::Select(const eckit::Configuration& config) : Action{config}, selection_{config} {}
 
 void Select::execute(Message msg) const {
     if (isMatched(msg)) {
@@ -42,11 +69,9 @@ bool Select::isMatched(const Message& msg) const {
 }
 
 bool Select::matchPlan(const Message& msg) const {
-    auto item = (match_ == "category") ? msg.category() : msg.name();
-
-    LOG_DEBUG_LIB(LibMultio) << " *** Item " << item << " is being matched... ";
+    LOG_DEBUG_LIB(LibMultio) << " *** Field " << msg.name() << " is being matched... ";
 
-    bool ret = find(begin(items_), end(items_), item) != end(items_);
+    bool ret = selection_.matches(msg.metadata());
 
     LOG_DEBUG_LIB(LibMultio) << (ret ? "found" : "not found") << std::endl;
 
@@ -54,13 +79,8 @@ bool Select::matchPlan(const Message& msg) const {
 }
 
 void Select::print(std::ostream& os) const {
-    os << "Select(categories=";
-    bool first = true;
-    for(const auto& cat : items_) {
-        os << (first ? "" : ", ");
-        os << cat;
-        first = false;
-    }
+    os << "Select(";
+    selection_.print(os);
     os << ")";
 }
 
@@ -18,6 +18,7 @@
 #define multio_server_actions_Select_H
 
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 #include "multio/action/Action.h"
@@ -29,6 +30,26 @@ namespace action {
 
 using message::Message;
 
+// The fields a Select action lets through: those whose name, or category, is listed. Also used on
+// the client to tell which fields plans select, without building them.
+class FieldSelection {
+public:
+    // Every field
+    FieldSelection() = default;
+
+    // From the configuration of a Select action
+    explicit FieldSelection(const eckit::Configuration& config);
+
+    bool matches(const message::Metadata& metadata) const;
+
+    void print(std::ostream& os) const;
+
+private:
+    bool all_ = true;
+    std::string match_;
+    std::vector<std::string> items_;
+};
+
 class Select : public Action {
 public:
     explicit Select(const eckit::Configuration& config);
@@ -42,9 +63,7 @@ private:
 
     bool matchPlan(const Message& msg) const;
 
-    std::string match_;
-    std::vector<std::string> items_;
-
+    FieldSelection selection_;
 };
 
 }  // namespace action
@@ -52,32 +52,31 @@ Statistics::Statistics(const eckit::Configuration& config) :
 
 void Statistics::execute(message::Message msg) const {
 
-    std::ostringstream os;
     auto md = msg.metadata();
+    const StatisticsKey key{msg.fieldKey().field(), msg.fieldKey().identity(), msg.source()};
     {
         eckit::AutoTiming timing{statistics_.timer_, statistics_.actionTiming_};
 
         LOG_DEBUG_LIB(LibMultio) << "*** " << msg.destination() << " -- metadata: " << md
                                  << std::endl;
 
-        // Create a unique key for the fieldStats_ map
-        os << msg.metadata().getString("category") << msg.metadata().getString("nemoParam")
-           << msg.metadata().getString("param") << msg.metadata().getLong("level") << msg.source();
-
-        if (fieldStats_.find(os.str()) == end(fieldStats_)) {
-            fieldStats_[os.str()] =
-                TemporalStatistics::build(timeUnit_, timeSpan_, operations_, msg);
+        auto it = fieldStats_.find(key);
+        if (it == end(fieldStats_)) {
+            it = fieldStats_
+                     .emplace(key, TemporalStatistics::build(timeUnit_, timeSpan_, operations_, msg))
+                     .first;
         }
 
-        if (fieldStats_.at(os.str())->process(msg)) {
+        if (it->second->process(msg)) {
             return;
         }
 
         md.set("timeUnit", timeUnit_);
         md.set("timeSpan", timeSpan_);
-        md.set("stepRange", fieldStats_.at(os.str())->stepRange(md.getLong("step")));
+        md.set("stepRange", it->second->stepRange(md.getLong("step")));
     }
-    for (auto&& stat : fieldStats_.at(os.str())->compute(msg)) {
+    auto& fieldStats = fieldStats_.at(key);
+    for (auto&& stat : fieldStats->compute(msg)) {
         md.set("operation", stat.first);
         message::Message newMsg{message::Message::Header{message::Message::Tag::Field, msg.source(),
                                                          msg.destination(), message::Metadata{md}},
@@ -87,7 +86,7 @@ void Statistics::execute(message::Message msg) const {
     }
 
     eckit::AutoTiming timing{statistics_.timer_, statistics_.actionTiming_};
-    fieldStats_.at(os.str())->reset(msg);
+    fieldStats->reset(msg);
 }
 
 void Statistics::print(std::ostream& os) const {
@@ -16,7 +16,11 @@
 #ifndef multio_server_actions_Statistics_H
 #define multio_server_actions_Statistics_H
 
+#include <cstdint>
 #include <iosfwd>
+#include <map>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "multio/action/Action.h"
@@ -42,7 +46,10 @@ private:
 
     const std::vector<std::string> operations_;
 
-    mutable std::map<std::string, std::unique_ptr<TemporalStatistics>> fieldStats_;
+    // Statistics are computed for the partial fields, hence they are unique per field and source.
+    // Fields are told apart by their identity too, as their hashes may collide.
+    using StatisticsKey = std::tuple<std::uint64_t, std::string, message::Peer>;
+    mutable std::map<StatisticsKey, std::unique_ptr<TemporalStatistics>> fieldStats_;
 };
 
 }  // namespace action
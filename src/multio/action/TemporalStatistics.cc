@@ -6,6 +6,7 @@
 
 #include "eckit/exception/Exceptions.h"
 #include "multio/LibMultio.h"
+#include "multio/message/BufferPool.h"
 
 namespace multio {
 namespace action {
@@ -90,12 +91,12 @@ void TemporalStatistics::resetPeriod(const message::Message& msg) {
     current_.reset(currentDateTime(msg));
 }
 
-std::map<std::string, eckit::Buffer> TemporalStatistics::compute(const message::Message& msg) {
-    std::map<std::string, eckit::Buffer> retStats;
+std::map<std::string, message::Payload> TemporalStatistics::compute(const message::Message& msg) {
+    std::map<std::string, message::Payload> retStats;
     for (auto const& stat : statistics_) {
-        eckit::Buffer buf{msg.size()};
+        auto buf = message::BufferPool::instance().allocate(msg.size());
         const auto& res = stat->compute();
-        std::memcpy(buf, res.data(), msg.size());
+        std::memcpy(buf.data(), res.data(), msg.size());
         retStats.emplace(stat->name(), std::move(buf));
     }
     return retStats;
@@ -25,7 +25,7 @@ public:
     virtual ~TemporalStatistics() = default;
 
     bool process(message::Message& msg);
-    std::map<std::string, eckit::Buffer> compute(const message::Message& msg);
+    std::map<std::string, message::Payload> compute(const message::Message& msg);
     std::string stepRange(long step);
     void reset(const message::Message& msg);
 
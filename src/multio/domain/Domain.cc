@@ -2,11 +2,13 @@
 #include "Domain.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "eckit/exception/Exceptions.h"
 
 #include "multio/message/Message.h"
 #include "multio/LibMultio.h"
+#include "multio/domain/ScatterPool.h"
 
 namespace multio {
 namespace domain {
@@ -15,30 +17,113 @@ Domain::Domain(std::vector<int32_t>&& def) : definition_(std::move(def)) {}
 
 //------------------------------------------------------------------------------------------------------------
 
-Unstructured::Unstructured(std::vector<int32_t>&& def) : Domain{std::move(def)} {}
+namespace {
+
+// Shorter runs are scattered point by point, as a call to memcpy costs more than it saves
+const int32_t minimumRunLength = 8;
+
+}  // namespace
+
+Unstructured::Unstructured(std::vector<int32_t>&& def) :
+    Domain{std::move(def)}, size_{definition_.size()} {
+    // Segments are the work items of the scatter pool, so none may take more than a chunk's share
+    auto maximumLength = static_cast<int32_t>(
+        std::max<size_t>(minimumRunLength, size_ / ScatterPool::instance().chunks()));
+
+    auto scatter = [this, maximumLength](size_t local, int32_t id) {
+        if (segments_.empty() || segments_.back().length > 0 ||
+            segments_.back().length == -maximumLength) {
+            segments_.push_back(Segment{local, static_cast<int32_t>(scattered_.size()), 0});
+        }
+        --segments_.back().length;
+        scattered_.push_back(id);
+    };
+
+    size_t first = 0;
+    while (first != size_) {
+        auto last = first + 1;
+        while (last != size_ && definition_[last] == definition_[last - 1] + 1) {
+            ++last;
+        }
+
+        auto length = static_cast<int32_t>(last - first);
+        if (length >= minimumRunLength) {
+            for (auto idx = first; idx < last; idx += maximumLength) {
+                auto piece = std::min(maximumLength, static_cast<int32_t>(last - idx));
+                segments_.push_back(Segment{idx, definition_[idx], piece});
+            }
+        }
+        else {
+            for (auto idx = first; idx != last; ++idx) {
+                scatter(idx, definition_[idx]);
+            }
+        }
+        first = last;
+    }
+
+    // The segments replace the map
+    definition_.clear();
+    definition_.shrink_to_fit();
+    scattered_.shrink_to_fit();
+    segments_.shrink_to_fit();
+}
 
 void Unstructured::to_local(const std::vector<double>& global, std::vector<double>& local) const {
     local.resize(0);
-    std::for_each(begin(definition_), end(definition_),
-                  [&](int32_t id) { local.push_back(global[id]); });
+    for (auto id : global_indices()) {
+        local.push_back(global[id]);
+    }
 }
 
 void Unstructured::to_global(const message::Message& local, message::Message& global) const {
     auto levelCount = local.metadata().getLong("levelCount", 1);
-    ASSERT(local.payload().size() == definition_.size() * levelCount * sizeof(double));
+    ASSERT(local.payload().size() == size_ * levelCount * sizeof(double));
 
     auto lit = static_cast<const double*>(local.payload().data());
     auto git = static_cast<double*>(global.payload().data());
-    for (long lev = 0; lev != levelCount; ++lev) {
-        for (auto id : definition_) {
-            auto offset = id + lev * local.globalSize();
-            *(git + offset) = *lit++;
+    auto globalSize = local.globalSize();
+
+    // Work items are the segments of all levels
+    auto count = static_cast<size_t>(levelCount) * segments_.size();
+    ScatterPool::instance().run(count, levelCount * size_, [&](size_t first, size_t last) {
+        for (auto item = first; item != last; ++item) {
+            auto lev = item / segments_.size();
+            const auto& seg = segments_[item % segments_.size()];
+
+            auto src = lit + lev * size_ + seg.local;
+            auto dst = git + lev * globalSize;
+            if (seg.length > 0) {
+                std::memcpy(dst + seg.global, src, seg.length * sizeof(double));
+            }
+            else {
+                auto it = begin(scattered_) + seg.global;
+                for (auto end = it - seg.length; it != end; ++it) {
+                    *(dst + *it) = *src++;
+                }
+            }
         }
-    }
+    });
 
     eckit::Log::debug<LibMultio>() << " *** Aggregation completed..." << std::endl;
 }
 
+std::vector<int32_t> Unstructured::global_indices() const {
+    std::vector<int32_t> indices;
+    indices.reserve(size_);
+    for (const auto& seg : segments_) {
+        if (seg.length > 0) {
+            for (auto id = seg.global; id != seg.global + seg.length; ++id) {
+                indices.push_back(id);
+            }
+        }
+        else {
+            auto it = begin(scattered_) + seg.global;
+            indices.insert(end(indices), it, it - seg.length);
+        }
+    }
+    return indices;
+}
+
 //------------------------------------------------------------------------------------------------------------
 
 namespace {
@@ -86,11 +171,16 @@ void Structured::to_global(const message::Message& local, message::Message& glob
             std::to_string(data_nj));
     }
 
-    auto lit = static_cast<const double*>(local.payload().data());
     auto git = static_cast<double*>(global.payload().data());
-    for (long lev = 0; lev != levelCount; ++lev) {
-        auto offset = lev * local.globalSize();
-        for (auto j = data_jbegin; j != data_jbegin + data_nj; ++j) {
+    auto globalSize = local.globalSize();
+
+    // Work items are the rows of all levels
+    auto rows = static_cast<size_t>(levelCount * data_nj);
+    ScatterPool::instance().run(rows, rows * data_ni, [&](size_t first, size_t last) {
+        for (auto row = first; row != last; ++row) {
+            auto offset = (row / data_nj) * globalSize;
+            auto j = data_jbegin + static_cast<int32_t>(row % data_nj);
+            auto lit = static_cast<const double*>(local.payload().data()) + row * data_ni;
             for (auto i = data_ibegin; i != data_ibegin + data_ni; ++i, ++lit) {
                 if (inRange(i, 0, ni) && inRange(j, 0, nj)) {
                     auto gidx = offset + (jbegin + j) * ni_global + (ibegin + i);
@@ -98,8 +188,33 @@ void Structured::to_global(const message::Message& local, message::Message& glob
                 }
             }
         }
-    }
+    });
+
+}
+
+std::vector<int32_t> Structured::global_indices() const {
+    ASSERT(definition_.size() == 11);
+
+    auto ni_global = definition_[0];
+    auto ibegin = definition_[2];
+    auto ni = definition_[3];
+    auto jbegin = definition_[4];
+    auto nj = definition_[5];
+    auto data_ibegin = definition_[7];
+    auto data_ni = definition_[8];
+    auto data_jbegin = definition_[9];
+    auto data_nj = definition_[10];
 
+    std::vector<int32_t> indices;
+    indices.reserve(data_ni * data_nj);
+    for (auto j = data_jbegin; j != data_jbegin + data_nj; ++j) {
+        for (auto i = data_ibegin; i != data_ibegin + data_ni; ++i) {
+            indices.push_back((inRange(i, 0, ni) && inRange(j, 0, nj))
+                                  ? (jbegin + j) * ni_global + (ibegin + i)
+                                  : -1);
+        }
+    }
+    return indices;
 }
 
 //------------------------------------------------------------------------------------------------------------
@@ -114,5 +229,23 @@ void Spectral::to_global(const message::Message&, message::Message&) const {
     NOTIMP;
 }
 
+std::vector<int32_t> Spectral::global_indices() const {
+    NOTIMP;
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+std::unique_ptr<Domain> make_domain(const std::string& category, std::vector<int32_t>&& def) {
+    if (category == "unstructured") {
+        return std::unique_ptr<Domain>{new Unstructured{std::move(def)}};
+    }
+
+    if (category == "structured") {
+        return std::unique_ptr<Domain>{new Structured{std::move(def)}};
+    }
+
+    throw eckit::AssertionFailed("Unsupported domain category" + category);
+}
+
 }  // namespace domain
 }  // namespace multio
@@ -4,6 +4,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <eckit/io/Buffer.h>
@@ -24,6 +26,9 @@ public:
     virtual void to_local(const std::vector<double>& global, std::vector<double>& local) const = 0;
     virtual void to_global(const message::Message& local, message::Message& global) const = 0;
 
+    // Global index of every local point, or -1 for points that belong to another domain (halo)
+    virtual std::vector<int32_t> global_indices() const = 0;
+
 protected:
     std::vector<int32_t> definition_;  // Grid-point
 
@@ -36,6 +41,19 @@ public:
 private:
     void to_local(const std::vector<double>& global, std::vector<double>& local) const override;
     void to_global(const message::Message& local, message::Message& global) const override;
+    std::vector<int32_t> global_indices() const override;
+
+    // The index map, stored as runs of consecutive global indices that are copied as blocks. Points
+    // between runs that are too short to be worth it are kept as they are in scattered_. Long runs
+    // are split, so that the scatter of a single level still spreads over the scatter pool.
+    struct Segment {
+        size_t local;    // Offset of the first point in the local field
+        int32_t global;  // First global index of a run, or first entry in scattered_
+        int32_t length;  // Negative for scattered points
+    };
+    std::vector<Segment> segments_;
+    std::vector<int32_t> scattered_;
+    size_t size_;
 };
 
 class Structured final : public Domain {
@@ -45,6 +63,7 @@ public:
 private:
     void to_local(const std::vector<double>& global, std::vector<double>& local) const override;
     void to_global(const message::Message& local, message::Message& global) const override;
+    std::vector<int32_t> global_indices() const override;
 };
 
 class Spectral final : public Domain {
@@ -54,8 +73,12 @@ public:
 private:
     void to_local(const std::vector<double>& global, std::vector<double>& local) const override;
     void to_global(const message::Message& local, message::Message& global) const override;
+    std::vector<int32_t> global_indices() const override;
 };
 
+// Builds a domain of the category, either "unstructured" or "structured", named in a domain message
+std::unique_ptr<Domain> make_domain(const std::string& category, std::vector<int32_t>&& def);
+
 }  // namespace domain
 }  // namespace multio
 
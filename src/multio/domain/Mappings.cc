@@ -40,22 +40,11 @@ void Mappings::add(message::Message msg) {
     util::print_buffer(local_map, eckit::Log::debug<LibMultio>());
     eckit::Log::debug<LibMultio>() << "]" << std::endl;
 
-    if (msg.category() == "unstructured") {
-        mapping.emplace(msg.source(),
-                        std::unique_ptr<Domain>{new Unstructured{std::move(local_map)}});
-        return;
-    }
-
-    if (msg.category() == "structured") {
-        mapping.emplace(msg.source(),
-                        std::unique_ptr<Domain>{new Structured{std::move(local_map)}});
-        return;
-    }
-
-    throw eckit::AssertionFailed("Unsupported domain category" + msg.category());
+    mapping.emplace(msg.source(), make_domain(msg.category(), std::move(local_map)));
 }
 
 void Mappings::list(std::ostream& out) const {
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
     auto sep = "";
     for (auto const& map : mappings_) {
         out << sep << map.first;
@@ -66,6 +55,7 @@ void Mappings::list(std::ostream& out) const {
 const Mapping& Mappings::get(const std::string& name) const {
     // Must exist
     eckit::Log::debug<LibMultio>() << "*** Fetch mappings for " << name << std::endl;
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
     auto it = mappings_.find(name);
     if (it != end(mappings_)) {
         return it->second;
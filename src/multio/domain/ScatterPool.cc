@@ -0,0 +1,134 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "ScatterPool.h"
+
+#include <algorithm>
+
+#include "eckit/config/Resource.h"
+
+#include "multio/LibMultio.h"
+
+namespace multio {
+namespace domain {
+
+namespace {
+
+const size_t defaultThreads = 4;
+
+// Below a million values, i.e. 8 MiB, waking threads costs about as much as it saves
+const size_t defaultMinimumSize = 1024 * 1024;
+
+// Several chunks per thread even out the work of parts with halos or uneven levels
+const size_t chunksPerThread = 4;
+
+size_t thread_count() {
+    size_t threads =
+        eckit::Resource<size_t>("multioScatterThreads;$MULTIO_SCATTER_THREADS", defaultThreads);
+    auto hardware = static_cast<size_t>(std::thread::hardware_concurrency());
+    return hardware == 0 ? threads : std::min(threads, hardware);
+}
+
+}  // namespace
+
+ScatterPool& ScatterPool::instance() {
+    static ScatterPool singleton;
+    return singleton;
+}
+
+ScatterPool::ScatterPool() :
+    minimumSize_{eckit::Resource<size_t>(
+        "multioScatterMinimumSize;$MULTIO_SCATTER_MINIMUM_SIZE", defaultMinimumSize)} {
+    // The calling thread does its share, so one thread means no pool at all
+    auto threads = thread_count();
+    for (size_t ii = 1; ii < threads; ++ii) {
+        threads_.emplace_back(&ScatterPool::loop, this);
+    }
+
+    eckit::Log::debug<LibMultio>() << "ScatterPool: " << threads_.size()
+                                   << " threads for parts of at least " << minimumSize_
+                                   << " values" << std::endl;
+}
+
+ScatterPool::~ScatterPool() {
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ScatterPool::run(size_t count, size_t size, const Work& work) {
+    if (threads_.empty() || count < 2 || size < minimumSize_) {
+        work(0, count);
+        return;
+    }
+
+    std::unique_lock<std::mutex> submit{submit_, std::try_to_lock};
+    if (not submit.owns_lock()) {
+        work(0, count);
+        return;
+    }
+
+    auto chunks = std::min(count, this->chunks());
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        work_ = &work;
+        count_ = count;
+        chunk_ = (count + chunks - 1) / chunks;
+        next_.store(0, std::memory_order_relaxed);
+        busy_ = threads_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    take();
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    done_.wait(lock, [this]() { return busy_ == 0; });
+    work_ = nullptr;
+}
+
+size_t ScatterPool::chunks() const {
+    return (threads_.size() + 1) * chunksPerThread;
+}
+
+void ScatterPool::loop() {
+    size_t seen = 0;
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+        wake_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+        if (stop_) {
+            return;
+        }
+        seen = generation_;
+
+        lock.unlock();
+        take();
+        lock.lock();
+
+        if (--busy_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void ScatterPool::take() {
+    size_t first;
+    while ((first = next_.fetch_add(chunk_, std::memory_order_relaxed)) < count_) {
+        (*work_)(first, std::min(first + chunk_, count_));
+    }
+}
+
+}  // namespace domain
+}  // namespace multio
@@ -0,0 +1,79 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_domain_ScatterPool_H
+#define multio_domain_ScatterPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace multio {
+namespace domain {
+
+// Threads shared by all domains for scattering large parts into global fields. A range of work
+// items is cut into chunks that the calling thread and the pool's threads take in turn. Parts
+// smaller than a threshold, and parts arriving while the pool is busy with another one, are
+// scattered by the calling thread alone, so that small fields stay serial and dispatcher threads
+// never wait for each other.
+//
+// Chunks must write to disjoint memory, which holds as the domains of a field do not overlap, and
+// must not throw.
+
+class ScatterPool {
+public:
+    using Work = std::function<void(size_t first, size_t last)>;
+
+    static ScatterPool& instance();
+
+    ScatterPool(const ScatterPool&) = delete;
+    ScatterPool& operator=(const ScatterPool&) = delete;
+
+    // Runs `work` over [0, count); `size` is the number of values that covers
+    void run(size_t count, size_t size, const Work& work);
+
+    // How many work items a range is cut into when run on the pool
+    size_t chunks() const;
+
+private:
+    ScatterPool();
+    ~ScatterPool();
+
+    void loop();
+    void take();
+
+    const size_t minimumSize_;
+
+    std::mutex submit_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Work* work_ = nullptr;
+    size_t count_ = 0;
+    size_t chunk_ = 0;
+    std::atomic<size_t> next_{0};
+    size_t busy_ = 0;
+    size_t generation_ = 0;
+    bool stop_ = false;
+
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace domain
+}  // namespace multio
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "eckit/config/Resource.h"
+#include "eckit/io/Buffer.h"
+
+namespace multio {
+namespace message {
+
+namespace {
+
+const size_t defaultMinimumSize = 64 * 1024;
+const size_t defaultMaximumCached = 1024 * 1024 * 1024;
+
+size_t size_class(size_t size, size_t minimumSize) {
+    auto pow2 = minimumSize;
+    while (pow2 <= size / 2) {
+        pow2 *= 2;
+    }
+
+    auto step = pow2 / 4;
+    return ((size + step - 1) / step) * step;
+}
+
+}  // namespace
+
+void BufferPoolStatistics::report(std::ostream& out, const char* indent) const {
+    reportCount(out, "    -- Pool hits", hits_, indent);
+    reportCount(out, "    -- Pool misses", misses_, indent);
+    reportCount(out, "    -- Unpooled allocations", unpooled_, indent);
+    reportCount(out, "    -- Discarded blocks", discarded_, indent);
+    reportBytes(out, "    -- Bytes in use", bytesInUse_, indent);
+    reportBytes(out, "    -- Bytes cached", bytesCached_, indent);
+    reportBytes(out, "    -- High-water mark", highWaterMark_, indent);
+}
+
+BufferPool& BufferPool::instance() {
+    // Never destroyed: payloads released during static destruction still return their blocks
+    static BufferPool* pool = new BufferPool{};
+    return *pool;
+}
+
+BufferPool::BufferPool() :
+    minimumSize_{eckit::Resource<size_t>(
+        "multioBufferPoolMinimumSize;$MULTIO_BUFFER_POOL_MINIMUM_SIZE", defaultMinimumSize)},
+    maximumCached_{eckit::Resource<size_t>(
+        "multioBufferPoolMaximumCached;$MULTIO_BUFFER_POOL_MAXIMUM_CACHED", defaultMaximumCached)} {}
+
+Payload BufferPool::allocate(size_t size) {
+    if (size < minimumSize_) {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            ++statistics_.unpooled_;
+        }
+        return Payload{eckit::Buffer{size}};
+    }
+
+    auto cls = size_class(size, minimumSize_);
+
+    std::unique_ptr<char[]> block;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        auto& blocks = free_[cls];
+        if (blocks.empty()) {
+            ++statistics_.misses_;
+        }
+        else {
+            ++statistics_.hits_;
+            block = std::move(blocks.back());
+            blocks.pop_back();
+            statistics_.bytesCached_ -= cls;
+        }
+
+        statistics_.bytesInUse_ += cls;
+        statistics_.highWaterMark_ = std::max(statistics_.highWaterMark_, statistics_.bytesInUse_);
+    }
+
+    if (not block) {
+        block.reset(new char[cls]);
+    }
+
+    auto data = block.release();
+    std::shared_ptr<void> owner{data,
+                                [this, cls](void* ptr) { release(cls, static_cast<char*>(ptr)); }};
+    return Payload{std::move(owner), data, size};
+}
+
+void BufferPool::release(size_t sizeClass, char* block) {
+    std::unique_ptr<char[]> owned{block};
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    statistics_.bytesInUse_ -= sizeClass;
+
+    if (statistics_.bytesCached_ + sizeClass > maximumCached_) {
+        ++statistics_.discarded_;
+        return;
+    }
+
+    statistics_.bytesCached_ += sizeClass;
+    free_[sizeClass].push_back(std::move(owned));
+}
+
+void BufferPool::report(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    out << "\n ** BufferPool(size classes=" << free_.size() << ")\n";
+    statistics_.report(out);
+}
+
+}  // namespace message
+}  // namespace multio
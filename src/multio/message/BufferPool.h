@@ -0,0 +1,75 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_message_BufferPool_H
+#define multio_message_BufferPool_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "eckit/log/Statistics.h"
+#include "eckit/memory/NonCopyable.h"
+
+#include "multio/message/Payload.h"
+
+namespace multio {
+namespace message {
+
+class BufferPoolStatistics : public eckit::Statistics {
+public:
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+    std::size_t unpooled_ = 0;
+    std::size_t discarded_ = 0;
+
+    std::size_t bytesInUse_ = 0;
+    std::size_t bytesCached_ = 0;
+    std::size_t highWaterMark_ = 0;
+
+    void report(std::ostream& out, const char* indent = "") const;
+};
+
+// Process-wide recycling pool for large payload buffers. Sizes are rounded up to one of four size
+// classes per power of two, so that fields of the same few sizes keep reusing the same blocks.
+// Blocks return to the pool when the last payload referring to them is released.
+
+class BufferPool : private eckit::NonCopyable {
+public:
+    static BufferPool& instance();
+
+    // Requests below the minimum pooled size are served by the allocator directly
+    Payload allocate(size_t size);
+
+    void report(std::ostream& out) const;
+
+private:
+    BufferPool();
+
+    void release(size_t sizeClass, char* block);
+
+    const size_t minimumSize_;
+    const size_t maximumCached_;
+
+    mutable std::mutex mutex_;
+    std::map<size_t, std::vector<std::unique_ptr<char[]>>> free_;
+
+    BufferPoolStatistics statistics_;
+};
+
+}  // namespace message
+}  // namespace multio
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "FieldKey.h"
+
+#include <iomanip>
+#include <iostream>
+
+#include "eckit/serialisation/Stream.h"
+
+namespace multio {
+namespace message {
+
+namespace {
+
+// FNV-1a -- unlike std::hash, it is stable across processes and platforms, which matters as the
+// key is computed on the client and interpreted on the server
+const std::uint64_t fnvOffsetBasis = 14695981039346656037ull;
+const std::uint64_t fnvPrime = 1099511628211ull;
+
+std::uint64_t hash_bytes(std::uint64_t hash, const void* data, size_t sz) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t ii = 0; ii != sz; ++ii) {
+        hash ^= bytes[ii];
+        hash *= fnvPrime;
+    }
+    return hash;
+}
+
+// Appends the value to the identity, and hashes the bytes appended
+std::uint64_t add_value(std::uint64_t hash, std::string& identity, const Metadata& metadata,
+                        const char* key) {
+    auto first = identity.size();
+    if (metadata.has(key)) {
+        if (metadata.isString(key)) {
+            identity += 's';
+            identity += metadata.getString(key);
+        }
+        else if (metadata.isIntegral(key)) {
+            identity += 'i';
+            identity += std::to_string(metadata.getLong(key));
+        }
+    }
+    // Separator also distinguishes absent keys and value types
+    identity += '\x1f';
+    return hash_bytes(hash, identity.data() + first, identity.size() - first);
+}
+
+const char* identityKeys[] = {"category", "name",      "nemoParam", "param",
+                              "level",    "operation", "domain",    "gridSubtype"};
+
+}  // namespace
+
+FieldKey::FieldKey(std::uint64_t field, long step, std::string identity) :
+    field_{field}, step_{step}, identity_{std::move(identity)} {}
+
+FieldKey::FieldKey(const Metadata& metadata) :
+    field_{fnvOffsetBasis}, step_{metadata.getLong(Metadata::Key::step, 0)} {
+    for (auto key : identityKeys) {
+        field_ = add_value(field_, identity_, metadata, key);
+    }
+}
+
+
+std::uint64_t FieldKey::field() const {
+    return field_;
+}
+
+long FieldKey::step() const {
+    return step_;
+}
+
+const std::string& FieldKey::identity() const {
+    return identity_;
+}
+
+std::uint64_t FieldKey::hash() const {
+    auto step = static_cast<std::int64_t>(step_);
+    return hash_bytes(field_, &step, sizeof(step));
+}
+
+bool FieldKey::operator==(const FieldKey& rhs) const {
+    return field_ == rhs.field_ && step_ == rhs.step_ && identity_ == rhs.identity_;
+}
+
+bool FieldKey::operator!=(const FieldKey& rhs) const {
+    return not operator==(rhs);
+}
+
+bool FieldKey::operator<(const FieldKey& rhs) const {
+    if (field_ != rhs.field_) {
+        return field_ < rhs.field_;
+    }
+    return (step_ != rhs.step_) ? (step_ < rhs.step_) : (identity_ < rhs.identity_);
+}
+
+void FieldKey::encode(eckit::Stream& strm) const {
+    strm << static_cast<unsigned long long>(field_);
+    strm << step_;
+    strm << identity_;
+}
+
+FieldKey FieldKey::decode(eckit::Stream& strm) {
+    unsigned long long field;
+    strm >> field;
+    long step;
+    strm >> step;
+    std::string identity;
+    strm >> identity;
+    return FieldKey{static_cast<std::uint64_t>(field), step, std::move(identity)};
+}
+
+void FieldKey::print(std::ostream& out) const {
+    out << "FieldKey(field=" << std::hex << std::setw(16) << std::setfill('0') << field_
+        << std::dec << std::setfill(' ') << ",step=" << step_ << ")";
+}
+
+}  // namespace message
+}  // namespace multio
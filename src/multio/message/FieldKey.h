@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_message_FieldKey_H
+#define multio_message_FieldKey_H
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+#include "multio/message/Metadata.h"
+
+namespace eckit {
+class Stream;
+}
+
+namespace multio {
+namespace message {
+
+// Compact identity of a field, computed once from the metadata on the client and transported with
+// the message header. The field hash identifies the field across steps (category, name, param,
+// level, ...) and is what routing and temporal statistics key on. The step completes the identity
+// of one particular output field, as needed for aggregation.
+//
+// Equality does not rely on the hash alone: keys also carry the identity values the hash is computed
+// from, so that fields whose hashes collide still compare different.
+
+class FieldKey {
+public:
+    FieldKey() = default;
+    FieldKey(std::uint64_t field, long step, std::string identity);
+    explicit FieldKey(const Metadata& metadata);
+
+    std::uint64_t field() const;
+    long step() const;
+
+    // The values the field hash is computed from; together with the hash, identifies the field
+    // across steps without relying on the hash alone
+    const std::string& identity() const;
+
+    std::uint64_t hash() const;
+
+    bool operator==(const FieldKey& rhs) const;
+    bool operator!=(const FieldKey& rhs) const;
+    bool operator<(const FieldKey& rhs) const;
+
+    void encode(eckit::Stream& strm) const;
+    static FieldKey decode(eckit::Stream& strm);
+
+private:
+    void print(std::ostream& out) const;
+
+    friend std::ostream& operator<<(std::ostream& s, const FieldKey& x) {
+        x.print(s);
+        return s;
+    }
+
+    std::uint64_t field_ = 0;
+    long step_ = 0;
+    std::string identity_;
+};
+
+}  // namespace message
+}  // namespace multio
+
+namespace std {
+template <>
+struct hash<multio::message::FieldKey> {
+    size_t operator()(const multio::message::FieldKey& key) const {
+        return static_cast<size_t>(key.hash());
+    }
+};
+}  // namespace std
+
+#endif
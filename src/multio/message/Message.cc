@@ -15,11 +15,12 @@
 
 #include "eccodes.h"
 
-#include "eckit/config/YAMLConfiguration.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/message/Message.h"
 #include "eckit/serialisation/Stream.h"
 
+#include "multio/message/BufferPool.h"
+
 #include "metkit/codes/CodesContent.h"
 #include "metkit/codes/UserDataContent.h"
 
@@ -27,7 +28,7 @@ namespace multio {
 namespace message {
 
 int Message::protocolVersion() {
-    return 1;
+    return 3;
 }
 
 std::string Message::tag2str(Tag t) {
@@ -45,12 +46,21 @@ std::string Message::tag2str(Tag t) {
     return m.find(t)->second;
 }
 
-Message::Message() : Message(Message::Header{Message::Tag::Empty, Peer{}, Peer{}}) {}
+Message Message::decode(eckit::Stream& strm) {
+    auto header = Header::decode(strm);
+
+    unsigned long sz;
+    strm >> sz;
+
+    auto payload = BufferPool::instance().allocate(sz);
+    strm.readBlob(payload.data(), sz);
+
+    return Message{std::move(header), std::move(payload)};
+}
 
-Message::Message(Header&& header, const eckit::Buffer& payload) :
-    version_{protocolVersion()}, content_{std::make_shared<Content>(std::move(header), payload)} {}
+Message::Message() : Message(Message::Header{Message::Tag::Empty, Peer{}, Peer{}}) {}
 
-Message::Message(Header&& header, eckit::Buffer&& payload) :
+Message::Message(Header&& header, Payload payload) :
     version_{protocolVersion()},
     content_{std::make_shared<Content>(std::move(header), std::move(payload))} {}
 
@@ -94,19 +104,23 @@ std::string Message::domain() const {
     return header().domain();
 }
 
-const std::string& Message::fieldId() const {
+std::string Message::fieldId() const {
     return header().fieldId();
 }
 
+const FieldKey& Message::fieldKey() const {
+    return header().fieldKey();
+}
+
 const Metadata& Message::metadata() const {
     return header().metadata();
 }
 
-eckit::Buffer& Message::payload() {
+Payload& Message::payload() {
     return content_->payload();
 }
 
-const eckit::Buffer& Message::payload() const {
+const Payload& Message::payload() const {
     return content_->payload();
 }
 
@@ -114,12 +128,20 @@ size_t Message::size() const {
     return content_->size();
 }
 
+Message Message::own() const {
+    if (not payload().borrowed()) {
+        return *this;
+    }
+    return Message{Header{header()}, payload().own()};
+}
+
 void Message::encode(eckit::Stream& strm) const {
     header().encode(strm);
 
     strm << content_->size();
 
-    strm << content_->payload();
+    // Serialised straight from the payload memory, which may be borrowed from the caller
+    strm.writeBlob(payload().data(), payload().size());
 }
 
 void Message::print(std::ostream& out) const {
@@ -22,7 +22,9 @@
 
 #include "eckit/io/Buffer.h"
 
+#include "multio/message/FieldKey.h"
 #include "multio/message/Metadata.h"
+#include "multio/message/Payload.h"
 #include "multio/message/Peer.h"
 
 namespace eckit {
@@ -55,8 +57,10 @@ public:  // types
 
     class Header {
     public:
-        Header(Tag tag, Peer src, Peer dst, std::string&& fieldId);
         Header(Tag tag, Peer src, Peer dst, Metadata&& md = message::Metadata{});
+        Header(Tag tag, Peer src, Peer dst, Metadata&& md, const FieldKey& key);
+
+        static Header decode(eckit::Stream& strm);
 
         Tag tag() const;
 
@@ -73,7 +77,8 @@ public:  // types
 
         std::string domain() const;
 
-        const std::string& fieldId() const;
+        std::string fieldId() const;
+        const FieldKey& fieldKey() const;
 
         void encode(eckit::Stream& strm) const;
 
@@ -86,33 +91,33 @@ public:  // types
         const Peer destination_;
 
         const Metadata metadata_;
-        const std::string fieldId_; // Make that a hash?
+        const FieldKey fieldKey_;
     };
 
     class Content {
     public:
-        Content(Header&& header, const eckit::Buffer& payload = eckit::Buffer(0));
-        Content(Header&& header, eckit::Buffer&& payload);
+        Content(Header&& header, Payload&& payload);
 
         size_t size() const;
 
         const Header& header();
 
-        eckit::Buffer& payload();
-        const eckit::Buffer& payload() const;
+        Payload& payload();
+        const Payload& payload() const;
 
     private:
         const Header header_;
-        eckit::Buffer payload_;
+        Payload payload_;
     };
 
 public:  // methods
     static int protocolVersion();
     static std::string tag2str(Tag t);
 
+    static Message decode(eckit::Stream& strm);
+
     Message();
-    Message(Header&& header, const eckit::Buffer& payload = eckit::Buffer(0));
-    Message(Header&& header, eckit::Buffer&& payload);
+    Message(Header&& header, Payload payload = Payload{});
 
     const Header& header() const;
 
@@ -132,14 +137,18 @@ public:  // methods
 
     std::string domain() const;
 
-    const std::string& fieldId() const;
+    std::string fieldId() const;
+    const FieldKey& fieldKey() const;
     const Metadata& metadata() const;
 
-    eckit::Buffer& payload();
-    const eckit::Buffer& payload() const;
+    Payload& payload();
+    const Payload& payload() const;
 
     size_t size() const;
 
+    // Returns this message if its payload is owned, otherwise a copy that owns its payload
+    Message own() const;
+
     void encode(eckit::Stream& strm) const;
 
 private:  // methods
@@ -13,11 +13,7 @@
 namespace multio {
 namespace message {
 
-Message::Content::Content(Header&& header, const eckit::Buffer& payload) :
-    header_{std::move(header)},
-    payload_{payload, payload.size()} {}
-
-Message::Content::Content(Header&& header, eckit::Buffer&& payload) :
+Message::Content::Content(Header&& header, Payload&& payload) :
     header_{std::move(header)},
     payload_{std::move(payload)} {}
 
@@ -25,11 +21,11 @@ const Message::Header& Message::Content::header() {
     return header_;
 };
 
-eckit::Buffer& Message::Content::payload() {
+Payload& Message::Content::payload() {
     return payload_;
 }
 
-const eckit::Buffer& Message::Content::payload() const {
+const Payload& Message::Content::payload() const {
     return payload_;
 }
 
@@ -10,25 +10,55 @@
 
 #include "Message.h"
 
-#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/exception/Exceptions.h"
 #include "eckit/serialisation/Stream.h"
 
 namespace multio {
 namespace message {
 
-Message::Header::Header(Tag tag, Peer src, Peer dst, std::string&& fieldId) :
+Message::Header::Header(Tag tag, Peer src, Peer dst, Metadata&& md) :
     tag_{tag},
-        source_{std::move(src)},
-        destination_{std::move(dst)},
-        metadata_{message::to_metadata(fieldId)},
-        fieldId_{std::move(fieldId)} {}
+    source_{std::move(src)},
+    destination_{std::move(dst)},
+    metadata_{std::move(md)},
+    fieldKey_{metadata_} {}
 
-Message::Header::Header(Tag tag, Peer src, Peer dst, Metadata&& md) :
+Message::Header::Header(Tag tag, Peer src, Peer dst, Metadata&& md, const FieldKey& key) :
     tag_{tag},
     source_{std::move(src)},
     destination_{std::move(dst)},
     metadata_{std::move(md)},
-    fieldId_{message::to_string(metadata_)} {}
+    fieldKey_{key} {}
+
+Message::Header Message::Header::decode(eckit::Stream& strm) {
+    unsigned version;
+    strm >> version;
+
+    if (version != static_cast<unsigned>(Message::protocolVersion())) {
+        throw eckit::SeriousBug("Unsupported wire protocol version " + std::to_string(version) +
+                                    " -- expected version " +
+                                    std::to_string(Message::protocolVersion()),
+                                Here());
+    }
+
+    unsigned t;
+    strm >> t;
+
+    std::string src_grp;
+    strm >> src_grp;
+    size_t src_id;
+    strm >> src_id;
+
+    std::string dest_grp;
+    strm >> dest_grp;
+    size_t dest_id;
+    strm >> dest_id;
+
+    auto key = FieldKey::decode(strm);
+
+    return Header{static_cast<Tag>(t), Peer{src_grp, src_id}, Peer{dest_grp, dest_id},
+                  decode_metadata(strm), key};
+}
 
 Message::Tag Message::Header::tag() const {
     return tag_;
@@ -47,30 +77,36 @@ const Metadata& Message::Header::metadata() const {
 }
 
 std::string Message::Header::name() const {
-    return metadata_.getString("name");
+    return metadata_.getString(Metadata::Key::name);
 }
 
 std::string Message::Header::category() const {
-    return metadata_.getString("category");
+    return metadata_.getString(Metadata::Key::category);
 }
 
 size_t Message::Header::domainCount() const {
-    return metadata_.getUnsigned("domainCount");
+    return metadata_.getUnsigned(Metadata::Key::domainCount);
 }
 
 long Message::Header::globalSize() const {
-    return metadata_.getLong("globalSize");
+    return metadata_.getLong(Metadata::Key::globalSize);
 }
 
 std::string Message::Header::domain() const {
-    return metadata_.getString("domain");
+    return metadata_.getString(Metadata::Key::domain);
 }
 
-const std::string& Message::Header::fieldId() const {
-    return fieldId_;
+std::string Message::Header::fieldId() const {
+    return to_string(metadata_);
+}
+
+const FieldKey& Message::Header::fieldKey() const {
+    return fieldKey_;
 }
 
 void Message::Header::encode(eckit::Stream& strm) const {
+    strm << static_cast<unsigned>(Message::protocolVersion());
+
     strm << static_cast<unsigned>(tag_);
 
     strm << source_.group();
@@ -79,7 +115,9 @@ void Message::Header::encode(eckit::Stream& strm) const {
     strm << destination_.group();
     strm << destination_.id();
 
-    strm << fieldId_;
+    fieldKey_.encode(strm);
+
+    encode_metadata(strm, metadata_);
 }
 
 }  // namespace message
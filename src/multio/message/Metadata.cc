@@ -1,26 +1,868 @@
 
 #include "Metadata.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
+#include "eckit/config/LocalConfiguration.h"
 #include "eckit/config/YAMLConfiguration.h"
+#include "eckit/exception/Exceptions.h"
 #include "eckit/log/JSON.h"
+#include "eckit/serialisation/Stream.h"
 
 namespace multio {
 namespace message {
 
+namespace {
+
+const unsigned wellKnownCount = static_cast<unsigned>(Metadata::Key::COUNT);
+
+const std::array<std::string, wellKnownCount> wellKnownKeys{
+    {"name", "category", "domain", "globalSize", "domainCount", "level", "step", "param"}};
+
+// Entries are typically a dozen or two; this covers what the clients set without reallocating
+const size_t initialCapacity = 16;
+
+bool well_known_id(const std::string& key, unsigned& id) {
+    for (unsigned ii = 0; ii != wellKnownCount; ++ii) {
+        if (key == wellKnownKeys[ii]) {
+            id = ii;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Process-wide table of interned key names. The well-known keys occupy the first ids and are
+// resolved by comparison. Other keys are looked up in an immutable snapshot of the table, without
+// locking; interning a new key, which only happens the first few times metadata is decoded, copies
+// the snapshot under the lock and publishes the copy. Snapshots are kept until the end of the
+// process, as readers may still hold older ones; with the few dozen keys in use this stays small.
+class KeyRegistry {
+public:
+    static KeyRegistry& instance() {
+        static KeyRegistry registry;
+        return registry;
+    }
+
+    unsigned intern(const std::string& key) {
+        unsigned id;
+        if (lookup(key, id)) {
+            return id;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        const auto& current = *snapshots_.back();
+        auto it = current.ids.find(key);
+        if (it != end(current.ids)) {
+            return it->second;
+        }
+
+        id = wellKnownCount + static_cast<unsigned>(names_.size());
+        names_.push_back(key);  // References into a deque remain valid on growth
+
+        std::unique_ptr<Snapshot> next{new Snapshot(current)};
+        next->ids.emplace(key, id);
+        next->names.push_back(&names_.back());
+        snapshots_.push_back(std::move(next));
+        snapshot_.store(snapshots_.back().get(), std::memory_order_release);
+        return id;
+    }
+
+    bool lookup(const std::string& key, unsigned& id) const {
+        if (well_known_id(key, id)) {
+            return true;
+        }
+
+        const auto& ids = snapshot_.load(std::memory_order_acquire)->ids;
+        auto it = ids.find(key);
+        if (it == end(ids)) {
+            return false;
+        }
+        id = it->second;
+        return true;
+    }
+
+    const std::string& name(unsigned id) const {
+        if (id < wellKnownCount) {
+            return wellKnownKeys[id];
+        }
+
+        const auto& names = snapshot_.load(std::memory_order_acquire)->names;
+        ASSERT(id - wellKnownCount < names.size());
+        return *names[id - wellKnownCount];
+    }
+
+private:
+    struct Snapshot {
+        std::unordered_map<std::string, unsigned> ids;
+        std::vector<const std::string*> names;
+    };
+
+    KeyRegistry() : snapshots_(1) {
+        snapshots_.back().reset(new Snapshot{});
+        snapshot_.store(snapshots_.back().get(), std::memory_order_release);
+    }
+
+    std::atomic<const Snapshot*> snapshot_{nullptr};
+
+    std::mutex mutex_;
+    std::deque<std::string> names_;
+    std::vector<std::unique_ptr<const Snapshot>> snapshots_;
+};
+
+template <typename T>
+void encode_vector(eckit::Stream& strm, const std::vector<T>& vec) {
+    strm << static_cast<unsigned long>(vec.size());
+    for (const auto& val : vec) {
+        strm << val;
+    }
+}
+
+template <typename T>
+std::vector<T> decode_vector(eckit::Stream& strm) {
+    unsigned long sz;
+    strm >> sz;
+
+    std::vector<T> vec(sz);
+    for (auto& val : vec) {
+        strm >> val;
+    }
+    return vec;
+}
+
+template <typename T>
+void json_vector(eckit::JSON& json, const std::vector<T>& vec) {
+    json.startList();
+    for (const auto& val : vec) {
+        json << val;
+    }
+    json.endList();
+}
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+class Metadata::Value {
+public:
+    enum class Type : unsigned
+    {
+        Boolean = 0,
+        Integer,
+        Real,
+        String,
+        IntegerList,
+        RealList,
+        StringList,
+        SubMetadata
+    };
+
+    explicit Value(bool val) : type_{Type::Boolean} { boolean_ = val; }
+    explicit Value(long val) : type_{Type::Integer} { integer_ = val; }
+    explicit Value(double val) : type_{Type::Real} { real_ = val; }
+    explicit Value(std::string val) : type_{Type::String}, string_{std::move(val)} { integer_ = 0; }
+
+    explicit Value(std::vector<long> val) :
+        type_{Type::IntegerList}, object_{std::make_shared<const std::vector<long>>(std::move(val))} {
+        integer_ = 0;
+    }
+
+    explicit Value(std::vector<double> val) :
+        type_{Type::RealList}, object_{std::make_shared<const std::vector<double>>(std::move(val))} {
+        integer_ = 0;
+    }
+
+    explicit Value(std::vector<std::string> val) :
+        type_{Type::StringList},
+        object_{std::make_shared<const std::vector<std::string>>(std::move(val))} {
+        integer_ = 0;
+    }
+
+    explicit Value(const Metadata& val) :
+        type_{Type::SubMetadata}, object_{std::make_shared<const Metadata>(val)} {
+        integer_ = 0;
+    }
+
+    Type type() const { return type_; }
+
+    bool asBool(const std::string& key) const {
+        check(Type::Boolean, key, "a boolean");
+        return boolean_;
+    }
+
+    long asLong(const std::string& key) const {
+        check(Type::Integer, key, "an integer");
+        return integer_;
+    }
+
+    size_t asUnsigned(const std::string& key) const {
+        check(Type::Integer, key, "an integer");
+        if (integer_ < 0) {
+            throw eckit::BadValue("Metadata value for key '" + key + "' is negative", Here());
+        }
+        return static_cast<size_t>(integer_);
+    }
+
+    double asDouble(const std::string& key) const {
+        if (type_ == Type::Integer) {
+            return static_cast<double>(integer_);
+        }
+        check(Type::Real, key, "a real");
+        return real_;
+    }
+
+    const std::string& asString(const std::string& key) const {
+        check(Type::String, key, "a string");
+        return string_;
+    }
+
+    const std::vector<long>& asLongVector(const std::string& key) const {
+        check(Type::IntegerList, key, "an integer list");
+        return list<long>();
+    }
+
+    std::vector<double> asDoubleVector(const std::string& key) const {
+        if (type_ == Type::IntegerList) {
+            const auto& vec = list<long>();
+            return std::vector<double>(begin(vec), end(vec));
+        }
+        check(Type::RealList, key, "a real list");
+        return list<double>();
+    }
+
+    const std::vector<std::string>& asStringVector(const std::string& key) const {
+        check(Type::StringList, key, "a string list");
+        return list<std::string>();
+    }
+
+    const Metadata& asMetadata(const std::string& key) const {
+        check(Type::SubMetadata, key, "a metadata object");
+        return *std::static_pointer_cast<const Metadata>(object_);
+    }
+
+    void encode(eckit::Stream& strm) const {
+        strm << static_cast<unsigned>(type_);
+        switch (type_) {
+            case Type::Boolean:
+                strm << boolean_;
+                return;
+            case Type::Integer:
+                strm << integer_;
+                return;
+            case Type::Real:
+                strm << real_;
+                return;
+            case Type::String:
+                strm << string_;
+                return;
+            case Type::IntegerList:
+                encode_vector(strm, list<long>());
+                return;
+            case Type::RealList:
+                encode_vector(strm, list<double>());
+                return;
+            case Type::StringList:
+                encode_vector(strm, list<std::string>());
+                return;
+            case Type::SubMetadata:
+                encode_metadata(strm, *std::static_pointer_cast<const Metadata>(object_));
+                return;
+        }
+    }
+
+    static Value decode(eckit::Stream& strm) {
+        unsigned type;
+        strm >> type;
+
+        switch (static_cast<Type>(type)) {
+            case Type::Boolean: {
+                bool val;
+                strm >> val;
+                return Value{val};
+            }
+            case Type::Integer: {
+                long val;
+                strm >> val;
+                return Value{val};
+            }
+            case Type::Real: {
+                double val;
+                strm >> val;
+                return Value{val};
+            }
+            case Type::String: {
+                std::string val;
+                strm >> val;
+                return Value{std::move(val)};
+            }
+            case Type::IntegerList:
+                return Value{decode_vector<long>(strm)};
+            case Type::RealList:
+                return Value{decode_vector<double>(strm)};
+            case Type::StringList:
+                return Value{decode_vector<std::string>(strm)};
+            case Type::SubMetadata:
+                return Value{decode_metadata(strm)};
+        }
+        throw eckit::SeriousBug("Unknown metadata value type " + std::to_string(type), Here());
+    }
+
+    void json(eckit::JSON& json) const {
+        switch (type_) {
+            case Type::Boolean:
+                json << boolean_;
+                return;
+            case Type::Integer:
+                json << integer_;
+                return;
+            case Type::Real:
+                json << real_;
+                return;
+            case Type::String:
+                json << string_;
+                return;
+            case Type::IntegerList:
+                json_vector(json, list<long>());
+                return;
+            case Type::RealList:
+                json_vector(json, list<double>());
+                return;
+            case Type::StringList:
+                json_vector(json, list<std::string>());
+                return;
+            case Type::SubMetadata:
+                std::static_pointer_cast<const Metadata>(object_)->json(json);
+                return;
+        }
+    }
+
+    void configure(eckit::LocalConfiguration& config, const std::string& key) const {
+        switch (type_) {
+            case Type::Boolean:
+                config.set(key, boolean_);
+                return;
+            case Type::Integer:
+                config.set(key, integer_);
+                return;
+            case Type::Real:
+                config.set(key, real_);
+                return;
+            case Type::String:
+                config.set(key, string_);
+                return;
+            case Type::IntegerList:
+                config.set(key, list<long>());
+                return;
+            case Type::RealList:
+                config.set(key, list<double>());
+                return;
+            case Type::StringList:
+                config.set(key, list<std::string>());
+                return;
+            case Type::SubMetadata:
+                config.set(key, to_configuration(*std::static_pointer_cast<const Metadata>(object_)));
+                return;
+        }
+    }
+
+private:
+    void check(Type expected, const std::string& key, const char* what) const {
+        if (type_ != expected) {
+            throw eckit::BadValue("Metadata value for key '" + key + "' is not " + what, Here());
+        }
+    }
+
+    template <typename T>
+    const std::vector<T>& list() const {
+        return *std::static_pointer_cast<const std::vector<T>>(object_);
+    }
+
+    Type type_;
+
+    // Scalars are stored inline; lists and sub-metadata are immutable and shared between copies
+    union {
+        bool boolean_;
+        long integer_;
+        double real_;
+    };
+    std::string string_;
+    std::shared_ptr<const void> object_;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+struct Metadata::Entry {
+    unsigned id;
+    Value value;
+};
+
+class Metadata::Impl {
+public:
+    Impl() {
+        slots_.fill(-1);
+        entries_.reserve(initialCapacity);
+    }
+
+    const Value* find(unsigned id) const {
+        if (id < wellKnownCount) {
+            auto slot = slots_[id];
+            return (slot < 0) ? nullptr : &entries_[slot].value;
+        }
+
+        for (const auto& entry : entries_) {
+            if (entry.id == id) {
+                return &entry.value;
+            }
+        }
+        return nullptr;
+    }
+
+    void set(unsigned id, Value&& value) {
+        if (auto existing = find(id)) {
+            const_cast<Value&>(*existing) = std::move(value);
+            return;
+        }
+
+        if (id < wellKnownCount) {
+            slots_[id] = static_cast<int>(entries_.size());
+        }
+        entries_.push_back(Entry{id, std::move(value)});
+    }
+
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    void reserve(size_t sz) { entries_.reserve(sz); }
+
+private:
+    std::vector<Entry> entries_;
+    std::array<int, wellKnownCount> slots_;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* Metadata::key2str(Key key) {
+    return wellKnownKeys[static_cast<unsigned>(key)].c_str();
+}
+
+Metadata::Metadata() = default;
+
+Metadata::Metadata(const eckit::Configuration& config) {
+    for (const auto& key : config.keys()) {
+        if (config.isSubConfiguration(key)) {
+            set(key, Metadata{config.getSubConfiguration(key)});
+        }
+        else if (config.isBoolean(key)) {
+            set(key, config.getBool(key));
+        }
+        else if (config.isIntegral(key)) {
+            set(key, config.getLong(key));
+        }
+        else if (config.isFloatingPoint(key)) {
+            set(key, config.getDouble(key));
+        }
+        else if (config.isString(key)) {
+            set(key, config.getString(key));
+        }
+        else if (config.isIntegralList(key)) {
+            set(key, config.getLongVector(key));
+        }
+        else if (config.isFloatingPointList(key)) {
+            set(key, config.getDoubleVector(key));
+        }
+        else if (config.isStringList(key)) {
+            set(key, config.getStringVector(key));
+        }
+        else {
+            throw eckit::BadValue("Cannot convert configuration value for key '" + key + "' to metadata",
+                                  Here());
+        }
+    }
+}
+
+bool Metadata::empty() const {
+    return size() == 0;
+}
+
+size_t Metadata::size() const {
+    return impl_ ? impl_->entries().size() : 0;
+}
+
+bool Metadata::has(Key key) const {
+    return find(key) != nullptr;
+}
+
+bool Metadata::has(const std::string& key) const {
+    return find(key) != nullptr;
+}
+
+std::vector<std::string> Metadata::keys() const {
+    std::vector<std::string> result;
+    if (impl_) {
+        result.reserve(impl_->entries().size());
+        for (const auto& entry : impl_->entries()) {
+            result.push_back(KeyRegistry::instance().name(entry.id));
+        }
+    }
+    return result;
+}
+
+bool Metadata::isBoolean(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::Boolean;
+}
+
+bool Metadata::isIntegral(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::Integer;
+}
+
+bool Metadata::isFloatingPoint(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::Real;
+}
+
+bool Metadata::isString(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::String;
+}
+
+bool Metadata::isIntegralList(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::IntegerList;
+}
+
+bool Metadata::isFloatingPointList(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::RealList;
+}
+
+bool Metadata::isStringList(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::StringList;
+}
+
+bool Metadata::isSubConfiguration(const std::string& key) const {
+    auto val = find(key);
+    return val && val->type() == Value::Type::SubMetadata;
+}
+
+const std::string& Metadata::getString(Key key) const {
+    return get(key).asString(key2str(key));
+}
+
+long Metadata::getLong(Key key) const {
+    return get(key).asLong(key2str(key));
+}
+
+long Metadata::getLong(Key key, long defaultValue) const {
+    auto val = find(key);
+    return val ? val->asLong(key2str(key)) : defaultValue;
+}
+
+size_t Metadata::getUnsigned(Key key) const {
+    return get(key).asUnsigned(key2str(key));
+}
+
+std::string Metadata::getString(const std::string& key) const {
+    return get(key).asString(key);
+}
+
+std::string Metadata::getString(const std::string& key, const std::string& defaultValue) const {
+    auto val = find(key);
+    return val ? val->asString(key) : defaultValue;
+}
+
+bool Metadata::getBool(const std::string& key) const {
+    return get(key).asBool(key);
+}
+
+bool Metadata::getBool(const std::string& key, bool defaultValue) const {
+    auto val = find(key);
+    return val ? val->asBool(key) : defaultValue;
+}
+
+int Metadata::getInt(const std::string& key) const {
+    return static_cast<int>(get(key).asLong(key));
+}
+
+int Metadata::getInt(const std::string& key, int defaultValue) const {
+    auto val = find(key);
+    return val ? static_cast<int>(val->asLong(key)) : defaultValue;
+}
+
+long Metadata::getLong(const std::string& key) const {
+    return get(key).asLong(key);
+}
+
+long Metadata::getLong(const std::string& key, long defaultValue) const {
+    auto val = find(key);
+    return val ? val->asLong(key) : defaultValue;
+}
+
+size_t Metadata::getUnsigned(const std::string& key) const {
+    return get(key).asUnsigned(key);
+}
+
+size_t Metadata::getUnsigned(const std::string& key, size_t defaultValue) const {
+    auto val = find(key);
+    return val ? val->asUnsigned(key) : defaultValue;
+}
+
+double Metadata::getDouble(const std::string& key) const {
+    return get(key).asDouble(key);
+}
+
+double Metadata::getDouble(const std::string& key, double defaultValue) const {
+    auto val = find(key);
+    return val ? val->asDouble(key) : defaultValue;
+}
+
+std::vector<long> Metadata::getLongVector(const std::string& key) const {
+    return get(key).asLongVector(key);
+}
+
+std::vector<double> Metadata::getDoubleVector(const std::string& key) const {
+    return get(key).asDoubleVector(key);
+}
+
+std::vector<std::string> Metadata::getStringVector(const std::string& key) const {
+    return get(key).asStringVector(key);
+}
+
+Metadata Metadata::getSubConfiguration(const std::string& key) const {
+    return get(key).asMetadata(key);
+}
+
+Metadata& Metadata::set(Key key, const std::string& value) {
+    return setValue(static_cast<unsigned>(key), Value{value});
+}
+
+Metadata& Metadata::set(Key key, long value) {
+    return setValue(static_cast<unsigned>(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, bool value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, int value) {
+    return set(key, static_cast<long>(value));
+}
+
+Metadata& Metadata::set(const std::string& key, unsigned int value) {
+    return set(key, static_cast<long>(value));
+}
+
+Metadata& Metadata::set(const std::string& key, long value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, unsigned long value) {
+    ASSERT(value <= static_cast<unsigned long>(std::numeric_limits<long>::max()));
+    return set(key, static_cast<long>(value));
+}
+
+Metadata& Metadata::set(const std::string& key, long long value) {
+    ASSERT(value <= std::numeric_limits<long>::max() && value >= std::numeric_limits<long>::min());
+    return set(key, static_cast<long>(value));
+}
+
+Metadata& Metadata::set(const std::string& key, unsigned long long value) {
+    ASSERT(value <= static_cast<unsigned long long>(std::numeric_limits<long>::max()));
+    return set(key, static_cast<long>(value));
+}
+
+Metadata& Metadata::set(const std::string& key, double value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const char* value) {
+    return set(key, std::string{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const std::string& value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const std::vector<int>& value) {
+    return set(key, std::vector<long>(begin(value), end(value)));
+}
+
+Metadata& Metadata::set(const std::string& key, const std::vector<long>& value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const std::vector<double>& value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const std::vector<std::string>& value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const Metadata& value) {
+    return setValue(KeyRegistry::instance().intern(key), Value{value});
+}
+
+Metadata& Metadata::set(const std::string& key, const eckit::Configuration& value) {
+    return set(key, Metadata{value});
+}
+
+const Metadata::Value* Metadata::find(Key key) const {
+    return impl_ ? impl_->find(static_cast<unsigned>(key)) : nullptr;
+}
+
+const Metadata::Value* Metadata::find(const std::string& key) const {
+    if (not impl_) {
+        return nullptr;
+    }
+
+    unsigned id;
+    if (not KeyRegistry::instance().lookup(key, id)) {
+        return nullptr;
+    }
+    return impl_->find(id);
+}
+
+const Metadata::Value& Metadata::get(Key key) const {
+    auto val = find(key);
+    if (not val) {
+        throw eckit::UserError(std::string{"Metadata has no key '"} + key2str(key) + "'", Here());
+    }
+    return *val;
+}
+
+const Metadata::Value& Metadata::get(const std::string& key) const {
+    auto val = find(key);
+    if (not val) {
+        throw eckit::UserError("Metadata has no key '" + key + "'", Here());
+    }
+    return *val;
+}
+
+Metadata& Metadata::setValue(unsigned id, Value&& value) {
+    mutableImpl().set(id, std::move(value));
+    return *this;
+}
+
+Metadata::Impl& Metadata::mutableImpl() {
+    if (not impl_) {
+        impl_ = std::make_shared<Impl>();
+    }
+    else if (impl_.use_count() > 1) {
+        impl_ = std::make_shared<Impl>(*impl_);
+    }
+    return *impl_;
+}
+
+void Metadata::json(eckit::JSON& json) const {
+    // Sorted by key so that the representation does not depend on the order of insertion
+    std::vector<std::pair<std::string, const Value*>> sorted;
+    if (impl_) {
+        sorted.reserve(impl_->entries().size());
+        for (const auto& entry : impl_->entries()) {
+            sorted.emplace_back(KeyRegistry::instance().name(entry.id), &entry.value);
+        }
+    }
+    std::sort(begin(sorted), end(sorted),
+              [](const std::pair<std::string, const Value*>& lhs,
+                 const std::pair<std::string, const Value*>& rhs) { return lhs.first < rhs.first; });
+
+    json.startObject();
+    for (const auto& kv : sorted) {
+        json << kv.first;
+        kv.second->json(json);
+    }
+    json.endObject();
+}
+
+void Metadata::print(std::ostream& out) const {
+    out << to_string(*this);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 std::string to_string(const Metadata& metadata) {
     std::stringstream ss;
     eckit::JSON json(ss);
-    json << metadata;
+    metadata.json(json);
 
     return ss.str();
 }
 
 Metadata to_metadata(const std::string& fieldId) {
-    const eckit::Configuration& config{eckit::YAMLConfiguration{fieldId}};
+    return Metadata{eckit::YAMLConfiguration{fieldId}};
+}
+
+eckit::LocalConfiguration to_configuration(const Metadata& metadata) {
+    eckit::LocalConfiguration config;
+    if (metadata.impl_) {
+        for (const auto& entry : metadata.impl_->entries()) {
+            entry.value.configure(config, KeyRegistry::instance().name(entry.id));
+        }
+    }
+    return config;
+}
+
+Metadata to_metadata(const eckit::Configuration& config) {
     return Metadata{config};
 }
 
+// Well-known keys are sent as their id, any other key as the marker id followed by its name
+void encode_metadata(eckit::Stream& strm, const Metadata& metadata) {
+    strm << static_cast<unsigned long>(metadata.size());
+    if (not metadata.impl_) {
+        return;
+    }
+
+    for (const auto& entry : metadata.impl_->entries()) {
+        if (entry.id < wellKnownCount) {
+            strm << entry.id;
+        }
+        else {
+            strm << wellKnownCount;
+            strm << KeyRegistry::instance().name(entry.id);
+        }
+        entry.value.encode(strm);
+    }
+}
+
+Metadata decode_metadata(eckit::Stream& strm) {
+    unsigned long count;
+    strm >> count;
+
+    Metadata metadata;
+    if (count == 0) {
+        return metadata;
+    }
+
+    auto& impl = metadata.mutableImpl();
+    impl.reserve(count);
+    for (auto ii = 0ul; ii != count; ++ii) {
+        unsigned id;
+        strm >> id;
+        if (id == wellKnownCount) {
+            std::string key;
+            strm >> key;
+            id = KeyRegistry::instance().intern(key);
+        }
+        else if (id > wellKnownCount) {
+            throw eckit::SeriousBug("Invalid metadata key id " + std::to_string(id), Here());
+        }
+        impl.set(id, Metadata::Value::decode(strm));
+    }
+
+    return metadata;
+}
+
 }  // namespace message
 }  // namespace multio
@@ -17,16 +17,171 @@
 #ifndef multio_server_Metadata_H
 #define multio_server_Metadata_H
 
-#include "eckit/config/LocalConfiguration.h"
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace eckit {
+class Configuration;
+class JSON;
+class LocalConfiguration;
+class Stream;
+}
 
 namespace multio {
 namespace message {
 
-using Metadata = eckit::LocalConfiguration;
+// Flat metadata container carried by every message. Keys are interned and the values are stored
+// contiguously; the well-known keys below have dedicated slots and can be accessed without any
+// string comparison. Copies share their content until one of them is modified (copy-on-write), so
+// copying a message header is cheap. Mutating a Metadata object is not thread-safe, but copies of
+// it may be mutated concurrently.
+
+class Metadata {
+public:  // types
+    enum class Key : unsigned
+    {
+        name = 0,
+        category,
+        domain,
+        globalSize,
+        domainCount,
+        level,
+        step,
+        param,
+        COUNT
+    };
+
+    static const char* key2str(Key key);
+
+public:  // methods
+    Metadata();
+    explicit Metadata(const eckit::Configuration& config);
+
+    Metadata(const Metadata&) = default;
+    Metadata(Metadata&&) = default;
+
+    Metadata& operator=(const Metadata&) = default;
+    Metadata& operator=(Metadata&&) = default;
+
+    bool empty() const;
+    size_t size() const;
+
+    bool has(Key key) const;
+    bool has(const std::string& key) const;
+
+    std::vector<std::string> keys() const;
+
+    bool isBoolean(const std::string& key) const;
+    bool isIntegral(const std::string& key) const;
+    bool isFloatingPoint(const std::string& key) const;
+    bool isString(const std::string& key) const;
+    bool isIntegralList(const std::string& key) const;
+    bool isFloatingPointList(const std::string& key) const;
+    bool isStringList(const std::string& key) const;
+    bool isSubConfiguration(const std::string& key) const;
+
+    // Typed access to the well-known keys
+
+    const std::string& getString(Key key) const;
+    long getLong(Key key) const;
+    long getLong(Key key, long defaultValue) const;
+    size_t getUnsigned(Key key) const;
+
+    // Generic access
+
+    std::string getString(const std::string& key) const;
+    std::string getString(const std::string& key, const std::string& defaultValue) const;
+
+    bool getBool(const std::string& key) const;
+    bool getBool(const std::string& key, bool defaultValue) const;
+
+    int getInt(const std::string& key) const;
+    int getInt(const std::string& key, int defaultValue) const;
+
+    long getLong(const std::string& key) const;
+    long getLong(const std::string& key, long defaultValue) const;
+
+    size_t getUnsigned(const std::string& key) const;
+    size_t getUnsigned(const std::string& key, size_t defaultValue) const;
 
+    double getDouble(const std::string& key) const;
+    double getDouble(const std::string& key, double defaultValue) const;
+
+    std::vector<long> getLongVector(const std::string& key) const;
+    std::vector<double> getDoubleVector(const std::string& key) const;
+    std::vector<std::string> getStringVector(const std::string& key) const;
+
+    Metadata getSubConfiguration(const std::string& key) const;
+
+    Metadata& set(Key key, const std::string& value);
+    Metadata& set(Key key, long value);
+
+    Metadata& set(const std::string& key, bool value);
+    Metadata& set(const std::string& key, int value);
+    Metadata& set(const std::string& key, unsigned int value);
+    Metadata& set(const std::string& key, long value);
+    Metadata& set(const std::string& key, unsigned long value);
+    Metadata& set(const std::string& key, long long value);
+    Metadata& set(const std::string& key, unsigned long long value);
+    Metadata& set(const std::string& key, double value);
+    Metadata& set(const std::string& key, const char* value);
+    Metadata& set(const std::string& key, const std::string& value);
+    Metadata& set(const std::string& key, const std::vector<int>& value);
+    Metadata& set(const std::string& key, const std::vector<long>& value);
+    Metadata& set(const std::string& key, const std::vector<double>& value);
+    Metadata& set(const std::string& key, const std::vector<std::string>& value);
+    Metadata& set(const std::string& key, const Metadata& value);
+    Metadata& set(const std::string& key, const eckit::Configuration& value);
+
+private:  // types
+    class Value;
+    struct Entry;
+    class Impl;
+
+private:  // methods
+    const Value* find(Key key) const;
+    const Value* find(const std::string& key) const;
+
+    const Value& get(Key key) const;
+    const Value& get(const std::string& key) const;
+
+    Metadata& setValue(unsigned id, Value&& value);
+
+    Impl& mutableImpl();
+
+    void json(eckit::JSON& json) const;
+
+    void print(std::ostream& out) const;
+
+    friend std::ostream& operator<<(std::ostream& s, const Metadata& x) {
+        x.print(s);
+        return s;
+    }
+
+    friend std::string to_string(const Metadata& metadata);
+    friend eckit::LocalConfiguration to_configuration(const Metadata& metadata);
+    friend void encode_metadata(eckit::Stream& strm, const Metadata& metadata);
+    friend Metadata decode_metadata(eckit::Stream& strm);
+
+private:  // members
+    std::shared_ptr<Impl> impl_;
+};
+
+// JSON representation -- for debugging and logging only, not used on the wire
 std::string to_string(const Metadata& metadata);
 Metadata to_metadata(const std::string& fieldId);
 
+// Adapters for configuration-facing code
+eckit::LocalConfiguration to_configuration(const Metadata& metadata);
+Metadata to_metadata(const eckit::Configuration& config);
+
+// Typed binary representation used by the wire protocol
+void encode_metadata(eckit::Stream& strm, const Metadata& metadata);
+Metadata decode_metadata(eckit::Stream& strm);
+
 }  // namespace message
 }  // namespace multio
 
@@ -0,0 +1,51 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "Payload.h"
+
+#include "eckit/io/Buffer.h"
+
+namespace multio {
+namespace message {
+
+namespace {
+
+Payload make_owned(eckit::Buffer&& buffer) {
+    auto size = buffer.size();
+    auto owner = std::make_shared<eckit::Buffer>(std::move(buffer));
+    auto data = owner->data();
+    return Payload{std::move(owner), data, size};
+}
+
+}  // namespace
+
+Payload::Payload(eckit::Buffer&& buffer) : Payload{make_owned(std::move(buffer))} {}
+
+Payload::Payload(const eckit::Buffer& buffer) :
+    Payload{make_owned(eckit::Buffer{static_cast<const char*>(buffer.data()), buffer.size()})} {}
+
+Payload::Payload(std::shared_ptr<void> owner, void* data, size_t size) :
+    owner_{std::move(owner)}, data_{data}, size_{size} {}
+
+Payload::Payload(void* data, size_t size) : data_{data}, size_{size} {}
+
+Payload Payload::borrow(const void* data, size_t size) {
+    return Payload{const_cast<void*>(data), size};
+}
+
+Payload Payload::own() const {
+    if (not borrowed()) {
+        return *this;
+    }
+    return Payload{eckit::Buffer{static_cast<const char*>(data_), size_}};
+}
+
+}  // namespace message
+}  // namespace multio
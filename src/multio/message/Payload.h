@@ -0,0 +1,67 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_message_Payload_H
+#define multio_message_Payload_H
+
+#include <cstddef>
+#include <memory>
+
+namespace eckit {
+class Buffer;
+}
+
+namespace multio {
+namespace message {
+
+// Data carried by a message. A payload either owns its memory (possibly shared with other
+// payloads, e.g. when the same field is sent to every server) or borrows it from the caller.
+//
+// A borrowed payload does not extend the lifetime of the memory it refers to. It is only valid
+// until the call that was given it returns: transports serialise it straight into their outgoing
+// buffers, and anything that needs to keep the data beyond that point must call own() first. Once
+// MultioClient::sendField returns, the caller is therefore free to reuse its array.
+
+class Payload {
+public:
+    Payload() = default;
+
+    Payload(eckit::Buffer&& buffer);
+    Payload(const eckit::Buffer& buffer);
+
+    // Shares ownership of the memory with `owner`, e.g. a pooled or a receive buffer
+    Payload(std::shared_ptr<void> owner, void* data, size_t size);
+
+    static Payload borrow(const void* data, size_t size);
+
+    const void* data() const { return data_; }
+    void* data() { return data_; }
+
+    size_t size() const { return size_; }
+
+    bool borrowed() const { return size_ != 0 && not owner_; }
+
+    // Returns a payload that owns its memory, copying borrowed data if needed
+    Payload own() const;
+
+private:
+    Payload(void* data, size_t size);
+
+    std::shared_ptr<void> owner_;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace message
+}  // namespace multio
+
+#endif
@@ -17,9 +17,13 @@
 
 #include "eckit/config/Configuration.h"
 #include "eckit/config/LocalConfiguration.h"
+#include "eckit/config/Resource.h"
+#include "eckit/exception/Exceptions.h"
 
 #include "multio/LibMultio.h"
 #include "multio/action/Plan.h"
+#include "multio/message/BufferPool.h"
+#include "multio/server/ScopedThread.h"
 
 #include "multio/util/ScopedTimer.h"
 #include "multio/util/logfile_name.h"
@@ -29,31 +33,145 @@ using eckit::LocalConfiguration;
 namespace multio {
 namespace server {
 
-Dispatcher::Dispatcher(const eckit::Configuration& config) {
-    timer_.start();
+namespace {
 
-    eckit::Log::debug<LibMultio>() << config << std::endl;
+// Messages taken off a queue at a time
+const size_t batchSize = 64;
+
+const size_t workerQueueSize = 4 * 1024;
+
+size_t worker_count(const eckit::Configuration& config) {
+    auto count = config.getUnsigned(
+        "dispatcherThreads",
+        eckit::Resource<size_t>("multioDispatcherThreads;$MULTIO_DISPATCHER_THREADS", 1));
+    if (count == 0) {
+        throw eckit::UserError("Dispatcher needs at least one thread", Here());
+    }
+    return count;
+}
 
-    const std::vector<LocalConfiguration> plans = config.getSubConfigurations("plans");
-    for (const auto& cfg : plans) {
+}  // namespace
+
+Dispatcher::Worker::Worker(const eckit::Configuration& config, size_t workerCount) :
+    queue_{workerQueueSize} {
+    std::vector<LocalConfiguration> plans = config.getSubConfigurations("plans");
+    for (auto& cfg : plans) {
+        // Lets actions know whether other workers run the same plans
+        cfg.set("dispatcherThreads", workerCount);
         eckit::Log::debug<LibMultio>() << cfg << std::endl;
         plans_.emplace_back(new action::Plan(cfg));
     }
 }
 
+void Dispatcher::Worker::run(SpscQueue<message::Message>& queue) {
+    std::vector<message::Message> batch;
+    batch.reserve(batchSize);
+    while (queue.pop(batch, batchSize) != 0) {
+        process(batch);
+        batch.clear();
+    }
+}
+
+void Dispatcher::Worker::process(const std::vector<message::Message>& batch) {
+    util::ScopedTimer timer{busyTiming_};
+    for (const auto& msg : batch) {
+        for (const auto& plan : plans_) {
+            plan->process(msg);
+        }
+    }
+    messageCount_ += batch.size();
+}
+
+void Dispatcher::Worker::report(std::ostream& out, size_t id, double elapsed) const {
+    out << "\n ** Dispatcher worker " << id << " -- messages processed: " << messageCount_
+        << ", time spent processing: " << busyTiming_.elapsed_ << "s";
+    if (elapsed > 0) {
+        out << " (" << 100 * busyTiming_.elapsed_ / elapsed << "% utilisation)";
+    }
+    out << std::endl;
+}
+
+Dispatcher::Dispatcher(const eckit::Configuration& config, Consumed consumed) :
+    consumed_{std::move(consumed)} {
+    timer_.start();
+
+    eckit::Log::debug<LibMultio>() << config << std::endl;
+
+    auto count = worker_count(config);
+    for (auto ii = 0u; ii != count; ++ii) {
+        workers_.emplace_back(new Worker{config, count});
+    }
+}
+
 Dispatcher::~Dispatcher() {
     std::ofstream logFile{util::logfile_name(), std::ios_base::app};
     logFile << "\n ** Total wall-clock time spent in dispatcher " << eckit::Timing{timer_}.elapsed_
             << "s -- of which time spent with dispatching " << timing_ << "s" << std::endl;
+    for (auto ii = 0u; ii != workers_.size(); ++ii) {
+        workers_[ii]->report(logFile, ii, timing_.elapsed_);
+    }
+    message::BufferPool::instance().report(logFile);
 }
 
-void Dispatcher::dispatch(eckit::Queue<message::Message>& queue) {
+void Dispatcher::dispatch(SpscQueue<message::Message>& queue) {
     util::ScopedTimer timer{timing_};
-    message::Message msg;
-    while (queue.pop(msg) >= 0) {
-        for (const auto& plan : plans_) {
-            plan->process(msg);
+
+    std::vector<message::Message> batch;
+    batch.reserve(batchSize);
+
+    // No need for another hand-off
+    if (workers_.size() == 1) {
+        while (queue.pop(batch, batchSize) != 0) {
+            for (const auto& msg : batch) {
+                consumed(msg);
+            }
+            workers_.front()->process(batch);
+            batch.clear();
+        }
+        return;
+    }
+
+    // The workers' queues are closed before their threads are joined on every way out, so that
+    // an error while routing does not leave the workers waiting forever
+    struct Running {
+        std::vector<std::unique_ptr<Worker>>& workers;
+        std::vector<std::unique_ptr<ScopedThread>> threads;
+        ~Running() {
+            for (auto& worker : workers) {
+                worker->queue().close();
+            }
+            threads.clear();
         }
+    } running{workers_, {}};
+
+    for (auto& worker : workers_) {
+        running.threads.emplace_back(new ScopedThread{
+            std::thread{&Worker::run, worker.get(), std::ref(worker->queue())}});
+    }
+
+    while (queue.pop(batch, batchSize) != 0) {
+        for (auto& msg : batch) {
+            consumed(msg);
+            route(std::move(msg));
+        }
+        batch.clear();
+    }
+}
+
+void Dispatcher::consumed(const message::Message& msg) const {
+    if (consumed_) {
+        consumed_(msg);
+    }
+}
+
+void Dispatcher::route(message::Message&& msg) {
+    if (msg.tag() == message::Message::Tag::Field) {
+        workers_[msg.fieldKey().field() % workers_.size()]->queue().push(std::move(msg));
+        return;
+    }
+
+    for (auto& worker : workers_) {
+        worker->queue().push(message::Message{msg});
     }
 }
 
@@ -17,13 +17,16 @@
 #ifndef multio_server_Dispatcher_H
 #define multio_server_Dispatcher_H
 
+#include <functional>
+#include <iosfwd>
 #include <memory>
+#include <vector>
 
-#include "eckit/container/Queue.h"
 #include "eckit/log/Statistics.h"
 #include "eckit/memory/NonCopyable.h"
 
 #include "multio/message/Message.h"
+#include "multio/server/RingQueue.h"
 
 namespace eckit {
 class Configuration;
@@ -38,19 +41,54 @@ class Plan;
 
 namespace server {
 
+// Runs the plans on a pool of worker threads, each with its own copy of the plans. Fields are
+// sharded by field key, so that every field, across steps, is always processed by the same worker
+// and in the order received. Any other message, e.g. StepComplete, goes to every worker behind the
+// fields already queued, so it acts as a barrier per worker.
+//
+// Sinks are instantiated once per worker, so with more than one worker they must cope with several
+// instances writing concurrently.
+
 class Dispatcher : private eckit::NonCopyable {
 public:
-    Dispatcher(const eckit::Configuration& config);
+    // Called for every message as it is taken off the queue
+    using Consumed = std::function<void(const message::Message&)>;
+
+    Dispatcher(const eckit::Configuration& config, Consumed consumed = Consumed{});
     ~Dispatcher();
 
-    void dispatch(eckit::Queue<message::Message>& queue);
+    void dispatch(SpscQueue<message::Message>& queue);
 
 private:
+    class Worker : private eckit::NonCopyable {
+    public:
+        Worker(const eckit::Configuration& config, size_t workerCount);
+
+        void run(SpscQueue<message::Message>& queue);
+
+        void process(const std::vector<message::Message>& batch);
+
+        SpscQueue<message::Message>& queue() { return queue_; }
+
+        void report(std::ostream& out, size_t id, double elapsed) const;
+
+    private:
+        std::vector<std::unique_ptr<action::Plan>> plans_;
+        SpscQueue<message::Message> queue_;
+
+        size_t messageCount_ = 0;
+        eckit::Timing busyTiming_;
+    };
+
+    void consumed(const message::Message& msg) const;
+    void route(message::Message&& msg);
+
+    Consumed consumed_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
 
-    std::vector<std::unique_ptr<action::Plan>> plans_;
     eckit::Timing timing_;
     eckit::Timer timer_;
-
 };
 
 }  // namespace server
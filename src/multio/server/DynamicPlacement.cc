@@ -0,0 +1,103 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "DynamicPlacement.h"
+
+#include <limits>
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/Resource.h"
+#include "eckit/exception/Exceptions.h"
+
+#include "multio/LibMultio.h"
+#include "multio/message/FieldKey.h"
+
+namespace multio {
+namespace server {
+
+DynamicPlacement::DynamicPlacement(const eckit::Configuration& config, size_t serverCount) :
+    plans_(action::plan_outlines(config)),
+    allStateful_{not config.has("plans")},
+    lagScale_{config.getDouble(
+        "dynamicLagScale",
+        eckit::Resource<double>("multioDynamicLagScale;$MULTIO_DYNAMIC_LAG_SCALE", 1.0))},
+    backlogScale_{config.getUnsigned(
+        "dynamicBacklogScale",
+        eckit::Resource<size_t>("multioDynamicBacklogScale;$MULTIO_DYNAMIC_BACKLOG_SCALE",
+                                64 * 1024 * 1024))},
+    counts_(serverCount),
+    loads_(serverCount) {
+    ASSERT(serverCount != 0);
+    ASSERT(lagScale_ > 0 && backlogScale_ != 0);
+}
+
+size_t DynamicPlacement::place(const message::Metadata& metadata) {
+    auto field = message::FieldKey{metadata}.field();
+    auto it = placed_.find(field);
+    if (it != end(placed_)) {
+        return it->second.server;
+    }
+
+    auto id = leastLoadedServer();
+    ++counts_[id];
+    placed_.emplace(field, Placement{id, stateful(metadata)});
+    return id;
+}
+
+void DynamicPlacement::update(const std::vector<ServerLoad>& loads) {
+    ASSERT(loads.size() == counts_.size());
+    loads_ = loads;
+
+    size_t released = 0;
+    for (auto it = begin(placed_); it != end(placed_);) {
+        if (it->second.stateful) {
+            ++it;
+            continue;
+        }
+        --counts_[it->second.server];
+        it = placed_.erase(it);
+        ++released;
+    }
+
+    eckit::Log::debug<multio::LibMultio>()
+        << "DynamicPlacement: " << released << " fields without state to place afresh" << std::endl;
+}
+
+bool DynamicPlacement::stateful(const message::Metadata& metadata) const {
+    if (allStateful_) {
+        return true;
+    }
+
+    for (const auto& plan : plans_) {
+        if (plan.statisticsCount != 0 && plan.selects(metadata)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Like `even`, except that each server's field count is weighted by the load it last reported
+size_t DynamicPlacement::leastLoadedServer() const {
+    size_t best = 0;
+    auto bestScore = std::numeric_limits<double>::max();
+    for (size_t id = 0; id != counts_.size(); ++id) {
+        auto pressure = 1.0 + loads_[id].lag / lagScale_ +
+                        static_cast<double>(loads_[id].backlog) / backlogScale_;
+        auto score = static_cast<double>(counts_[id] + 1) * pressure;
+        if (score < bestScore) {
+            best = id;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+}  // namespace server
+}  // namespace multio
@@ -0,0 +1,78 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_DynamicPlacement_H
+#define multio_server_DynamicPlacement_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "multio/action/Plan.h"
+#include "multio/message/Metadata.h"
+#include "multio/server/Transport.h"
+
+namespace eckit {
+class Configuration;
+}  // namespace eckit
+
+namespace multio {
+namespace server {
+
+// Placement of fields on the servers that are least loaded. A new field goes to the server with
+// the lowest field count weighted by the lag and backlog it reported, so that a server that falls
+// behind gets a smaller share of the new fields.
+//
+// Loads are taken once per step rather than for every new field. At that point, fields that keep
+// no state on their server are placed afresh; fields that plans run statistics on stay where they
+// were first placed. Without plans in the configuration, every field counts as keeping state.
+// Placements depend only on the configuration, the loads and the order fields are seen in, so all
+// clients agree on them as long as they all see the same loads.
+
+class DynamicPlacement {
+public:
+    DynamicPlacement(const eckit::Configuration& config, size_t serverCount);
+
+    // Index of the server for the field
+    size_t place(const message::Metadata& metadata);
+
+    // Loads at the end of a step
+    void update(const std::vector<ServerLoad>& loads);
+
+    // Whether a plan keeps state on the server for the field
+    bool stateful(const message::Metadata& metadata) const;
+
+    const std::vector<size_t>& counts() const { return counts_; }
+
+private:
+    size_t leastLoadedServer() const;
+
+    std::vector<action::PlanOutline> plans_;
+    const bool allStateful_;
+
+    // How much lag and backlog count as much as one field more on a server
+    const double lagScale_;
+    const size_t backlogScale_;
+
+    struct Placement {
+        size_t server;
+        bool stateful;
+    };
+    std::map<std::uint64_t, Placement> placed_;
+    std::vector<size_t> counts_;
+    std::vector<ServerLoad> loads_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "FlowControl.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Bytes.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+// Well clear of the message tags, which are used as MPI tags for the data
+const int creditTag = 32000;
+
+const size_t messageOverhead = 256;
+
+const useconds_t creditPollInterval = 50;  // microseconds
+
+}  // namespace
+
+FlowControl::FlowControl(size_t window, const eckit::mpi::Comm& comm, TransportStatistics& stats) :
+    window_{window}, comm_{comm}, statistics_{stats} {}
+
+size_t FlowControl::cost(const message::Message& msg) {
+    return msg.size() + messageOverhead;
+}
+
+ServerLoad FlowControl::load(int server) {
+    collect();
+    auto it = load_.find(server);
+    return it == std::end(load_) ? ServerLoad{} : it->second;
+}
+
+void FlowControl::acquire(const message::Message& msg, const std::function<void()>& flush) {
+    auto server = static_cast<int>(msg.destination().id());
+    auto bytes = static_cast<long long>(cost(msg));
+
+    auto it = credit_.find(server);
+    if (it == std::end(credit_)) {
+        it = credit_.emplace(server, window_).first;
+    }
+    auto& credit = it->second;
+
+    // A message larger than the window only waits for half of it: the server returns credit in
+    // portions of a quarter window, so waiting for all of it might never end
+    auto needed = std::min(bytes, static_cast<long long>(window_ / 2));
+
+    if (credit < needed) {
+        collect();
+    }
+
+    if (credit < needed) {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.creditStallTiming_};
+        ++statistics_.creditStallCount_;
+        flush();
+        while (credit < needed) {
+            ::usleep(creditPollInterval);
+            collect();
+        }
+    }
+
+    credit -= bytes;
+}
+
+void FlowControl::awaitClosed() {
+    auto finished = [this]() {
+        for (const auto& credit : credit_) {
+            if (finished_.find(credit.first) == std::end(finished_)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    collect();
+    while (not finished()) {
+        ::usleep(creditPollInterval);
+        collect();
+    }
+}
+
+void FlowControl::collect() {
+    for (;;) {
+        auto status = comm_.iProbe(comm_.anySource(), creditTag);
+        if (status.error()) {
+            return;
+        }
+        unsigned long words[4] = {0, 0, 0, 0};
+        comm_.receive(words, 4, status.source(), creditTag);
+        credit_[status.source()] += words[0];
+
+        auto& load = load_[status.source()];
+        load.backlog = words[1];
+        load.lag = words[2] * 1e-6;
+
+        if (words[3] != 0) {
+            finished_.insert(status.source());
+        }
+    }
+}
+
+void FlowControl::received(const message::Message& msg) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    receivedTotal_ += cost(msg);
+    arrivals_.emplace_back(std::chrono::steady_clock::now(), receivedTotal_);
+}
+
+void FlowControl::consumed(const message::Message& msg, bool credit) {
+    auto client = static_cast<int>(msg.source().id());
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    consumedTotal_ += cost(msg);
+
+    if (not credit) {
+        return;
+    }
+
+    // Nothing is sent after closing; what is owed then goes back in the final grant
+    if (closed_[client]) {
+        return;
+    }
+    if (msg.tag() == message::Message::Tag::Close) {
+        closed_[client] = true;
+    }
+
+    auto& owed = owed_[client];
+    if (owed == 0) {
+        owedSince_[client] = std::chrono::steady_clock::now();
+    }
+    owed += cost(msg);
+    peakOwed_ = std::max(peakOwed_, owed);
+}
+
+void FlowControl::grant() {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    while (not grants_.empty() && grants_.front().request.test()) {
+        grants_.pop_front();
+    }
+
+    auto load = currentLoad();
+    auto now = std::chrono::steady_clock::now();
+
+    auto it = std::begin(owed_);
+    while (it != std::end(owed_)) {
+        auto last = closed_[it->first];
+        if (not last && it->second < window_ / 4) {
+            ++it;
+            continue;
+        }
+
+        auto lag = static_cast<unsigned long>(load.lag * 1e6);
+        grants_.push_back(Grant{{it->second, load.backlog, lag, last ? 1ul : 0ul},
+                                eckit::mpi::Request{}});
+        auto& grant = grants_.back();
+        grant.request = comm_.iSend(grant.words, 4, it->first, creditTag);
+
+        ++statistics_.creditGrantCount_;
+        statistics_.creditGrantSize_ += it->second;
+
+        auto since = owedSince_.find(it->first);
+        if (since != std::end(owedSince_)) {
+            heldTime_ += std::chrono::duration<double>(now - since->second).count();
+            owedSince_.erase(since);
+        }
+
+        if (last) {
+            it = owed_.erase(it);
+        }
+        else {
+            it->second = 0;
+            ++it;
+        }
+    }
+}
+
+void FlowControl::finish() {
+    grant();
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto& sent : grants_) {
+        comm_.wait(sent.request);
+    }
+    grants_.clear();
+}
+
+ServerLoad FlowControl::currentLoad() {
+    // Messages are consumed roughly in the order they arrived
+    while (not arrivals_.empty() && arrivals_.front().second <= consumedTotal_) {
+        arrivals_.pop_front();
+    }
+
+    ServerLoad load;
+    load.backlog = receivedTotal_ - std::min(receivedTotal_, consumedTotal_);
+    if (not arrivals_.empty()) {
+        load.lag = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                 arrivals_.front().first)
+                       .count();
+    }
+    return load;
+}
+
+void FlowControl::report(std::ostream& out) const {
+    if (not enabled()) {
+        return;
+    }
+    out << "    FlowControl(window=" << eckit::Bytes(window_)
+        << ", peak credit owed to a client=" << eckit::Bytes(peakOwed_)
+        << ", time credit was held for clients=" << heldTime_ << "s)\n";
+}
+
+}  // namespace server
+}  // namespace multio
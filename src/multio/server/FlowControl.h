@@ -0,0 +1,125 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_FlowControl_H
+#define multio_server_FlowControl_H
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "eckit/mpi/Comm.h"
+
+#include "multio/message/Message.h"
+#include "multio/server/Transport.h"
+#include "multio/server/TransportStatistics.h"
+
+namespace multio {
+namespace server {
+
+// Credit-based flow control between MPI clients and servers. Every client starts with a window of
+// byte credits for each server and spends them on every message it sends to that server. The
+// server hands the credit back once the message has been taken on for processing, i.e. when the
+// dispatcher picks it up, so that the data queued on a server is bounded by the number of clients
+// times the window however bursty the output.
+//
+// A message costs its payload size plus a fixed overhead, which both sides compute alike. Credits
+// travel as separate MPI messages with a tag of their own, which also carry the server's current
+// backlog so that clients can steer new fields away from servers that fall behind.
+//
+// When a client closes, the server returns all the credit it still owes it in a last grant marked
+// as final, and the client waits for that grant from every server before it goes. As grants from
+// a server to a client arrive in order, none is then left in flight. The listening thread sends the
+// final grants as soon as it has stopped and waits for all grants to complete, so that clients are
+// not held up until the server shuts down.
+
+class FlowControl {
+public:
+    FlowControl(size_t window, const eckit::mpi::Comm& comm, TransportStatistics& stats);
+
+    bool enabled() const { return window_ != 0; }
+
+    static size_t cost(const message::Message& msg);
+
+    // Client side: what `server` reported along with its last grant of credit
+    ServerLoad load(int server);
+
+    // Client side: blocks until `server` has credit for `msg`. Data buffered for the server must be
+    // sent before waiting, as it holds credit the server cannot return, so `flush` is called first.
+    void acquire(const message::Message& msg, const std::function<void()>& flush);
+
+    // Client side: once Close has been sent to all servers, blocks until every server this client
+    // has spent credit with has sent its final grant
+    void awaitClosed();
+
+    // Server side: to be called for every message received
+    void received(const message::Message& msg);
+
+    // Server side: may be called from any thread. Messages from clients that are not given credit
+    // still count towards the backlog.
+    void consumed(const message::Message& msg, bool credit = true);
+
+    // Server side: sends the credit that has become due; to be called by the listening thread
+    void grant();
+
+    // Server side: once every client has closed, sends the final grants and waits for all grants
+    // to complete; to be called by the listening thread
+    void finish();
+
+    void report(std::ostream& out) const;
+
+private:
+    // Picks up all credit that has arrived so far
+    void collect();
+
+    // Credit in bytes, backlog in bytes, lag in microseconds and whether this is the final grant
+    struct Grant {
+        unsigned long words[4];
+        eckit::mpi::Request request;
+    };
+
+    // Updates the age of the oldest data not yet consumed; requires the lock
+    ServerLoad currentLoad();
+
+    const size_t window_;
+    const eckit::mpi::Comm& comm_;
+    TransportStatistics& statistics_;
+
+    // Client side
+    std::map<int, long long> credit_;
+    std::map<int, ServerLoad> load_;
+    std::set<int> finished_;
+
+    // Server side
+    std::mutex mutex_;
+    std::map<int, size_t> owed_;
+    std::map<int, bool> closed_;
+    std::deque<Grant> grants_;
+    size_t peakOwed_ = 0;
+
+    // Since when credit has been owed to each client, and for how long credit was held in total
+    std::map<int, std::chrono::steady_clock::time_point> owedSince_;
+    double heldTime_ = 0;
+
+    // Cumulative cost received after each message, for working out how old the backlog is
+    std::deque<std::pair<std::chrono::steady_clock::time_point, size_t>> arrivals_;
+    size_t receivedTotal_ = 0;
+    size_t consumedTotal_ = 0;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
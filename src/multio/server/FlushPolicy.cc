@@ -0,0 +1,235 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "FlushPolicy.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "eckit/config/Configuration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Log.h"
+
+#include "multio/LibMultio.h"
+
+namespace multio {
+namespace server {
+
+double Batch::age() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - opened).count();
+}
+
+void FlushStatistics::report(std::ostream& out, const char* indent) const {
+    reportCount(out, "    -- Buffers sent full", fullCount_, indent);
+    reportCount(out, "    -- Buffers sent by policy", policyCount_, indent);
+    reportCount(out, "    -- Buffers sent on demand", forcedCount_, indent);
+    reportCount(out, "    -- Messages batched", messageCount_, indent);
+    reportBytes(out, "    -- Largest batch", largestBatch_, indent);
+    if (batchCount_ != 0) {
+        reportCount(out, "    -- Messages per batch", messageCount_ / batchCount_, indent);
+        reportBytes(out, "    -- Bytes per batch", byteCount_ / batchCount_, indent);
+        reportTime(out, "    -- Average batch age", totalAge_ / static_cast<double>(batchCount_),
+                   indent);
+    }
+}
+
+FlushPolicy::FlushPolicy(const eckit::Configuration&) {}
+
+bool FlushPolicy::flushAfter(const Batch&, const message::Message&) const {
+    return false;
+}
+
+void FlushPolicy::completed(size_t, double) {}
+
+void FlushPolicy::flushed(const Batch& batch, FlushReason reason) {
+    switch (reason) {
+        case FlushReason::full:
+            ++statistics_.fullCount_;
+            break;
+        case FlushReason::policy:
+            ++statistics_.policyCount_;
+            break;
+        case FlushReason::forced:
+            ++statistics_.forcedCount_;
+            break;
+    }
+
+    ++statistics_.batchCount_;
+    statistics_.messageCount_ += batch.messages;
+    statistics_.byteCount_ += batch.size;
+    statistics_.largestBatch_ = std::max(statistics_.largestBatch_, batch.size);
+    statistics_.totalAge_ += batch.age();
+}
+
+void FlushPolicy::report(std::ostream& out) const {
+    out << "\n ** " << *this << "\n";
+    statistics_.report(out);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+namespace {
+
+// Sends a buffer once it is filled beyond a fixed ratio
+class FillPolicy final : public FlushPolicy {
+public:
+    explicit FillPolicy(const eckit::Configuration& config) :
+        FlushPolicy{config}, threshold_{config.getDouble("threshold", 0.75)} {
+        ASSERT(0.0 < threshold_ && threshold_ <= 1.0);
+    }
+
+private:
+    bool shallFit(const Batch& batch, size_t) const override {
+        return static_cast<double>(batch.size) < threshold_ * static_cast<double>(batch.capacity);
+    }
+
+    void print(std::ostream& os) const override { os << "FillPolicy(threshold=" << threshold_ << ")"; }
+
+    const double threshold_;
+};
+
+// Bounds the time a message may wait in a buffer, as far as it can be checked when the next
+// message arrives
+class AgePolicy final : public FlushPolicy {
+public:
+    explicit AgePolicy(const eckit::Configuration& config) :
+        FlushPolicy{config}, maxAge_{config.getDouble("maxAge", 50.0) / 1000.0} {}
+
+private:
+    bool shallFit(const Batch& batch, size_t) const override { return batch.age() < maxAge_; }
+
+    bool flushAfter(const Batch& batch, const message::Message&) const override {
+        return batch.age() >= maxAge_;
+    }
+
+    void print(std::ostream& os) const override {
+        os << "AgePolicy(maxAge=" << maxAge_ * 1000.0 << "ms)";
+    }
+
+    const double maxAge_;
+};
+
+// Batches as much as fits until the end of a step, so that servers can start on a step as soon as
+// the clients have finished it
+class StepPolicy final : public FlushPolicy {
+public:
+    explicit StepPolicy(const eckit::Configuration& config) : FlushPolicy{config} {}
+
+private:
+    bool shallFit(const Batch&, size_t) const override { return true; }
+
+    bool flushAfter(const Batch&, const message::Message& msg) const override {
+        return msg.tag() == message::Message::Tag::StepComplete;
+    }
+
+    void print(std::ostream& os) const override { os << "StepPolicy()"; }
+};
+
+// Sizes batches so that sending one takes about the target latency, based on the rate at which
+// previous buffers were sent
+class AdaptivePolicy final : public FlushPolicy {
+public:
+    explicit AdaptivePolicy(const eckit::Configuration& config) :
+        FlushPolicy{config},
+        latency_{config.getDouble("latency", 10.0) / 1000.0},
+        minimumSize_{config.getUnsigned("minimumSize", 64 * 1024)} {}
+
+private:
+    bool shallFit(const Batch& batch, size_t sz) const override {
+        return rate_ == 0.0 || batch.size + sz <= std::max(minimumSize_, target_);
+    }
+
+    void completed(size_t bytes, double seconds) override {
+        if (seconds <= 0.0) {
+            return;
+        }
+
+        auto rate = static_cast<double>(bytes) / seconds;
+        rate_ = (rate_ == 0.0) ? rate : rate_ + (rate - rate_) / 8.0;
+        target_ = static_cast<size_t>(rate_ * latency_);
+    }
+
+    void print(std::ostream& os) const override {
+        os << "AdaptivePolicy(latency=" << latency_ * 1000.0 << "ms,rate=" << rate_
+           << "B/s,target=" << target_ << ")";
+    }
+
+    const double latency_;
+    const size_t minimumSize_;
+
+    double rate_ = 0.0;
+    size_t target_ = 0;
+};
+
+FlushPolicyBuilder<FillPolicy> FillPolicyBuilder("fill");
+FlushPolicyBuilder<AgePolicy> AgePolicyBuilder("age");
+FlushPolicyBuilder<StepPolicy> StepPolicyBuilder("step");
+FlushPolicyBuilder<AdaptivePolicy> AdaptivePolicyBuilder("adaptive");
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+FlushPolicyFactory& FlushPolicyFactory::instance() {
+    static FlushPolicyFactory singleton;
+    return singleton;
+}
+
+void FlushPolicyFactory::add(const std::string& name, const FlushPolicyBuilderBase* builder) {
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
+    ASSERT(factories_.find(name) == factories_.end());
+    factories_[name] = builder;
+}
+
+void FlushPolicyFactory::remove(const std::string& name) {
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
+    ASSERT(factories_.find(name) != factories_.end());
+    factories_.erase(name);
+}
+
+void FlushPolicyFactory::list(std::ostream& out) const {
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
+
+    const char* sep = "";
+    for (auto const& factory : factories_) {
+        out << sep << factory.first;
+        sep = ", ";
+    }
+}
+
+std::unique_ptr<FlushPolicy> FlushPolicyFactory::build(const eckit::Configuration& config) {
+    std::lock_guard<std::recursive_mutex> lock{mutex_};
+
+    auto name = config.getString("policy", "fill");
+
+    eckit::Log::debug<LibMultio>() << "Looking for FlushPolicyFactory [" << name << "]" << std::endl;
+
+    auto f = factories_.find(name);
+    if (f != factories_.end()) {
+        return std::unique_ptr<FlushPolicy>{f->second->make(config)};
+    }
+
+    std::ostringstream oss;
+    oss << "No FlushPolicyFactory called " << name << "; flush policies are: ";
+    list(oss);
+    throw eckit::UserError(oss.str(), Here());
+}
+
+FlushPolicyBuilderBase::FlushPolicyBuilderBase(const std::string& name) : name_(name) {
+    FlushPolicyFactory::instance().add(name, this);
+}
+
+FlushPolicyBuilderBase::~FlushPolicyBuilderBase() {
+    FlushPolicyFactory::instance().remove(name_);
+}
+
+}  // namespace server
+}  // namespace multio
@@ -0,0 +1,154 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_FlushPolicy_H
+#define multio_server_FlushPolicy_H
+
+#include <chrono>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "eckit/log/Statistics.h"
+#include "eckit/memory/NonCopyable.h"
+
+#include "multio/message/Message.h"
+
+namespace eckit {
+class Configuration;
+}
+
+namespace multio {
+namespace server {
+
+// State of an outgoing buffer that messages are being batched into
+struct Batch {
+    size_t size;
+    size_t capacity;
+    size_t messages;
+    std::chrono::steady_clock::time_point opened;
+
+    double age() const;
+};
+
+enum class FlushReason : unsigned
+{
+    full,
+    policy,
+    forced,
+};
+
+class FlushStatistics : public eckit::Statistics {
+public:
+    std::size_t fullCount_ = 0;
+    std::size_t policyCount_ = 0;
+    std::size_t forcedCount_ = 0;
+
+    std::size_t batchCount_ = 0;
+    std::size_t messageCount_ = 0;
+    std::size_t byteCount_ = 0;
+    std::size_t largestBatch_ = 0;
+    double totalAge_ = 0.0;
+
+    void report(std::ostream& out, const char* indent = "") const;
+};
+
+// Decides when a buffer of batched messages is sent. Configured in the transport's 'flush'
+// section, e.g.
+//
+//   flush :
+//     policy : fill
+//     threshold : 0.8
+
+class FlushPolicy : private eckit::NonCopyable {
+public:
+    explicit FlushPolicy(const eckit::Configuration& config);
+    virtual ~FlushPolicy() = default;
+
+    // Whether a message of `sz` bytes should still be added to the batch. Only asked when the
+    // message would fit.
+    virtual bool shallFit(const Batch& batch, size_t sz) const = 0;
+
+    // Whether the batch should be sent straight after `msg` was added to it
+    virtual bool flushAfter(const Batch& batch, const message::Message& msg) const;
+
+    // Feedback on how long it took for a batch of `bytes` to be sent. Only given for sends seen to
+    // complete while the pool was checking on them, not for those it had to wait for.
+    virtual void completed(size_t bytes, double seconds);
+
+    void flushed(const Batch& batch, FlushReason reason);
+
+    void report(std::ostream& out) const;
+
+protected:
+    virtual void print(std::ostream& os) const = 0;
+
+    friend std::ostream& operator<<(std::ostream& os, const FlushPolicy& policy) {
+        policy.print(os);
+        return os;
+    }
+
+private:
+    FlushStatistics statistics_;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+class FlushPolicyBuilderBase;
+
+class FlushPolicyFactory : private eckit::NonCopyable {
+public:
+    static FlushPolicyFactory& instance();
+
+    void add(const std::string& name, const FlushPolicyBuilderBase* builder);
+
+    void remove(const std::string& name);
+
+    void list(std::ostream&) const;
+
+    // Builds the policy named in the configuration's 'policy' entry
+    std::unique_ptr<FlushPolicy> build(const eckit::Configuration& config);
+
+private:
+    FlushPolicyFactory() = default;
+
+    std::map<std::string, const FlushPolicyBuilderBase*> factories_;
+
+    mutable std::recursive_mutex mutex_;
+};
+
+class FlushPolicyBuilderBase : private eckit::NonCopyable {
+public:
+    virtual FlushPolicy* make(const eckit::Configuration& config) const = 0;
+
+protected:
+    FlushPolicyBuilderBase(const std::string&);
+
+    virtual ~FlushPolicyBuilderBase();
+
+    std::string name_;
+};
+
+template <class T>
+class FlushPolicyBuilder final : public FlushPolicyBuilderBase {
+    FlushPolicy* make(const eckit::Configuration& config) const override { return new T(config); }
+
+public:
+    FlushPolicyBuilder(const std::string& name) : FlushPolicyBuilderBase(name) {}
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -13,6 +13,7 @@
 #include <memory>
 #include <typeinfo>
 
+#include "eckit/config/LocalConfiguration.h"
 #include "eckit/config/YAMLConfiguration.h"
 
 #include "multio/util/print_buffer.h"
@@ -36,9 +36,10 @@ namespace server {
 using message::Message;
 
 Listener::Listener(const eckit::Configuration& config, Transport& trans) :
-    dispatcher_{std::make_shared<Dispatcher>(config)},
+    dispatcher_{std::make_shared<Dispatcher>(
+        config, [&trans](const Message& msg) { trans.consumed(msg); })},
     transport_{trans},
-    msgQueue_(eckit::Resource<size_t>("multioMessageQueueSize;$MULTIO_MESSAGE_QUEUE_SIZE", 1024*1024)) {}
+    msgQueue_(eckit::Resource<size_t>("multioMessageQueueSize;$MULTIO_MESSAGE_QUEUE_SIZE", 64*1024)) {}
 
 void Listener::start() {
 
@@ -48,16 +49,24 @@ void Listener::start() {
 
     ScopedThread dpatchThread{std::thread{&Dispatcher::dispatch, dispatcher_, std::ref(msgQueue_)}};
 
+    // Messages handled here rather than by the dispatcher count as consumed straight away
+    bool endOfStream = false;
     do {
         Message msg = transport_.receive();
 
         switch (msg.tag()) {
+            case Message::Tag::Empty:
+                LOG_DEBUG_LIB(LibMultio) << "*** END of stream from " << transport_ << std::endl;
+                endOfStream = true;
+                break;
+
             case Message::Tag::Open:
                 connections_.insert(msg.source());
                 LOG_DEBUG_LIB(LibMultio)
                     << "*** OPENING connection to " << msg.source()
                     << ":    client count = " << clientCount_ << ", closed count = " << closedCount_
                     << ", connections = " << connections_.size() << std::endl;
+                transport_.consumed(msg);
                 break;
 
             case Message::Tag::Close:
@@ -67,12 +76,14 @@ void Listener::start() {
                     << "*** CLOSING connection to " << msg.source()
                     << ":    client count = " << clientCount_ << ", closed count = " << closedCount_
                     << ", connections = " << connections_.size() << std::endl;
+                transport_.consumed(msg);
                 break;
 
             case Message::Tag::Grib:
                 LOG_DEBUG_LIB(LibMultio)
                     << "*** Size of grib template: " << msg.size() << std::endl;
                GribTemplate::instance().add(msg);
+                transport_.consumed(msg);
                 break;
 
             case Message::Tag::Domain:
@@ -81,11 +92,13 @@ void Listener::start() {
                 checkConnection(msg.source());
                 clientCount_ = msg.domainCount();
                domain::Mappings::instance().add(msg);
+                transport_.consumed(msg);
                 break;
 
             case Message::Tag::StepNotification:
                 LOG_DEBUG_LIB(LibMultio)
                     << "*** Step notification received from: " << msg.source() << std::endl;
+                transport_.consumed(msg);
                 break;
 
             case Message::Tag::StepComplete:
@@ -107,7 +120,7 @@ void Listener::start() {
                 oss << "Unhandled message: " << msg << std::endl;
                 throw eckit::SeriousBug(oss.str());
         }
-    } while (moreConnections());
+    } while (not endOfStream && moreConnections());
 
     LOG_DEBUG_LIB(LibMultio) << "*** STOPPED listening loop " << std::endl;
 
@@ -120,6 +133,9 @@ void Listener::listen() {
     do {
         transport_.listen();
     } while (not msgQueue_.closed());
+
+    // Every Close has been taken on by now
+    transport_.stopListening();
 }
 
 bool Listener::moreConnections() const {
@@ -20,10 +20,9 @@
 #include <set>
 #include <memory>
 
-#include "eckit/container/Queue.h"
-
 #include "multio/message/Peer.h"
 #include "multio/message/Message.h"
+#include "multio/server/RingQueue.h"
 
 namespace eckit {
 class Configuration;
@@ -56,7 +55,7 @@ private:
 
     std::set<message::Peer> connections_;
 
-    eckit::Queue<message::Message> msgQueue_;
+    SpscQueue<message::Message> msgQueue_;
 };
 
 }  // namespace server
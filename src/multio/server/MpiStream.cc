@@ -1,73 +1,231 @@
 
 #include "MpiStream.h"
 
-#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/maths/Functions.h"
+
+#include "multio/message/BufferPool.h"
 
 namespace multio {
 namespace server {
 
-MpiBuffer::MpiBuffer(size_t maxBufSize) : content{maxBufSize} {}
+namespace {
+
+const size_t payloadAlignment = 8;
+const size_t frameHeaderSize = sizeof(uint64_t);
+const size_t partHeaderSize = frameHeaderSize + sizeof(FramePart);
+
+// Set in the length of a part; frames are never that long
+const uint64_t partFlag = uint64_t{1} << 63;
 
-bool MpiBuffer::isFree() {
-    return status == BufferStatus::available ||
-            (status == BufferStatus::transmitting && request.test());
+uint64_t frame_header(const MpiBuffer& buf) {
+    uint64_t header;
+    std::memcpy(&header, buf.content.data(), frameHeaderSize);
+    return header;
 }
 
+const std::map<BufferStatus, std::string>& status2str() {
+    static const std::map<BufferStatus, std::string> st2str{
+        {BufferStatus::available, "available"},
+        {BufferStatus::fillingUp, "fillingUp"},
+        {BufferStatus::transmitting, "transmitting"}};
+    return st2str;
+}
+
+}  // namespace
+
+MpiBuffer::MpiBuffer(size_t maxBufSize) : content{maxBufSize} {}
+
 MpiOutputStream::MpiOutputStream(MpiBuffer& buf) :
-    eckit::ResizableMemoryStream{buf.content}, buf_{buf} {}
+    buf_{buf}, pos_{frameHeaderSize}, opened_{std::chrono::steady_clock::now()} {}
 
 bool MpiOutputStream::canFitMessage(size_t sz) {
     return (position() + sz + 4096 < buf_.content.size());
 }
 
-bool MpiOutputStream::shallFitMessage(size_t sz) {
-    if (not canFitMessage(sz)) {
-        return false;
-    }
+void MpiOutputStream::messageWritten() {
+    ++messageCount_;
+}
 
-    // return true;
+size_t MpiOutputStream::messageCount() const {
+    return messageCount_;
+}
 
-   auto ratio = static_cast<double>(position()) / static_cast<double>(buf_.content.size());
+std::chrono::steady_clock::time_point MpiOutputStream::opened() const {
+    return opened_;
+}
 
-   std::random_device rd;   // Will be used to obtain a seed for the random number engine
-   std::mt19937 gen{rd()};  // Standard mersenne_twister_engine seeded with rd()
-   std::uniform_real_distribution<double> dis{0.5, 1.0};
-   auto randVal = dis(gen);
+void MpiOutputStream::writePayload(const message::Payload& payload) {
+    align();
+    if (payload.size() != 0) {
+        write(payload.data(), static_cast<long>(payload.size()));
+    }
+}
 
-   return ratio < randVal;
+size_t MpiOutputStream::position() const {
+    return pos_;
+}
+
+size_t MpiOutputStream::bytesWritten() const {
+    return pos_;
+}
+
+size_t MpiOutputStream::finalise(size_t trailing) {
+    auto frameSize = static_cast<uint64_t>(pos_ + trailing);
+    std::memcpy(buf_.content.data(), &frameSize, frameHeaderSize);
+    return pos_;
 }
 
 MpiBuffer& MpiOutputStream::buffer() const {
     return buf_;
 }
 
+size_t MpiOutputStream::writePart(const void* frame, const FramePart& part, size_t maxSize,
+                                  std::vector<char>& out) {
+    ASSERT(partHeaderSize < maxSize);
+    ASSERT(part.offset < part.frameSize);
+
+    auto sz = std::min(maxSize - partHeaderSize, static_cast<size_t>(part.frameSize - part.offset));
+    auto header = partFlag | static_cast<uint64_t>(partHeaderSize + sz);
+
+    out.resize(partHeaderSize + sz);
+    std::memcpy(out.data(), &header, frameHeaderSize);
+    std::memcpy(out.data() + frameHeaderSize, &part, sizeof(FramePart));
+    std::memcpy(out.data() + partHeaderSize, static_cast<const char*>(frame) + part.offset, sz);
+    return sz;
+}
+
+long MpiOutputStream::write(const void* data, long len) {
+    auto sz = static_cast<size_t>(len);
+    if (pos_ + sz > buf_.content.size()) {
+        buf_.content.resize(eckit::round(pos_ + sz, 8) + 4096, true);
+    }
+
+    std::memcpy(static_cast<char*>(buf_.content.data()) + pos_, data, sz);
+    pos_ += sz;
+
+    return len;
+}
+
+long MpiOutputStream::read(void*, long) {
+    throw eckit::NotImplemented(Here());
+}
+
 std::string MpiOutputStream::name() const {
-    static const std::map<BufferStatus, std::string> st2str{
-        {BufferStatus::available, "available"},
-        {BufferStatus::fillingUp, "fillingUp"},
-        {BufferStatus::transmitting, "transmitting"}};
+    return "MpiOutputStream(" + status2str().at(buf_.status) + ")";
+}
+
+void MpiOutputStream::align() {
+    auto padding = eckit::round(pos_, payloadAlignment) - pos_;
+    if (padding != 0) {
+        const char zeros[payloadAlignment] = {};
+        write(zeros, static_cast<long>(padding));
+    }
+}
 
-    return "MpiOutputStream(" + st2str.at(buf_.status) + ")";
+MpiInputStream::MpiInputStream(MpiBuffer& buf, size_t sz, Release release) :
+    data_{static_cast<char*>(buf.content.data())},
+    size_{sz},
+    pos_{frameHeaderSize},
+    sliceable_{true},
+    lease_{&buf, [release](MpiBuffer* leased) { release(*leased); }} {}
+
+MpiInputStream::MpiInputStream(char* data, size_t sz, std::function<void()> release) :
+    data_{data},
+    size_{sz},
+    pos_{frameHeaderSize},
+    sliceable_{false},
+    lease_{data, [release](char*) { release(); }} {}
+
+size_t MpiInputStream::frameSize(const MpiBuffer& buf) {
+    return frameSize(frame_header(buf));
 }
 
-MpiInputStream::MpiInputStream(MpiBuffer& buf, size_t sz) :
-    eckit::ResizableMemoryStream{buf.content}, buf_{buf}, size_{sz} {}
+size_t MpiInputStream::frameSize(uint64_t header) {
+    return static_cast<size_t>(header & ~partFlag);
+}
 
-MpiBuffer& MpiInputStream::buffer() const {
-    return buf_;
+bool MpiInputStream::isPart(uint64_t header) {
+    return (header & partFlag) != 0;
+}
+
+bool MpiInputStream::readPart(const MpiBuffer& buf, FramePart& part, const char*& data,
+                              size_t& size) {
+    auto header = frame_header(buf);
+    if ((header & partFlag) == 0) {
+        return false;
+    }
+
+    std::memcpy(&part, static_cast<const char*>(buf.content.data()) + frameHeaderSize,
+                sizeof(FramePart));
+    data = static_cast<const char*>(buf.content.data()) + partHeaderSize;
+    size = static_cast<size_t>(header & ~partFlag) - partHeaderSize;
+    ASSERT(part.offset + size <= part.frameSize);
+    return true;
+}
+
+message::Payload MpiInputStream::readPayload(size_t sz, bool zeroCopy) {
+    align();
+    ASSERT(pos_ + sz <= size_);
+    ASSERT(sliceable_ || not zeroCopy);
+
+    auto data = data_ + pos_;
+    pos_ += sz;
+
+    if (zeroCopy) {
+        return message::Payload{lease_, data, sz};
+    }
+    auto payload = message::BufferPool::instance().allocate(sz);
+    std::memcpy(payload.data(), data, sz);
+    return payload;
+}
+
+bool MpiInputStream::sliceable() const {
+    return sliceable_;
+}
+
+const char* MpiInputStream::readBytes(size_t sz) {
+    align();
+    ASSERT(pos_ + sz <= size_);
+
+    auto data = data_ + pos_;
+    pos_ += sz;
+    return data;
+}
+
+size_t MpiInputStream::position() const {
+    return pos_;
 }
 
 size_t MpiInputStream::size() const {
     return size_;
 }
 
+long MpiInputStream::write(const void*, long) {
+    throw eckit::NotImplemented(Here());
+}
+
+long MpiInputStream::read(void* data, long len) {
+    auto sz = static_cast<size_t>(len);
+    ASSERT(pos_ + sz <= size_);
+
+    std::memcpy(data, data_ + pos_, sz);
+    pos_ += sz;
+
+    return len;
+}
+
 std::string MpiInputStream::name() const {
-    static const std::map<BufferStatus, std::string> st2str{
-        {BufferStatus::available, "available"},
-        {BufferStatus::fillingUp, "fillingUp"},
-        {BufferStatus::transmitting, "transmitting"}};
+    return sliceable_ ? "MpiInputStream(buffer)" : "MpiInputStream(borrowed)";
+}
 
-    return "MpiInputStream(" + st2str.at(buf_.status) + ")";
+void MpiInputStream::align() {
+    pos_ = eckit::round(pos_, payloadAlignment);
 }
 
 }
@@ -7,9 +7,17 @@
 #ifndef multio_server_MpiStream_H
 #define multio_server_MpiStream_H
 
-#include "eckit/mpi/Comm.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "eckit/io/Buffer.h"
-#include "eckit/serialisation/ResizableMemoryStream.h"
+#include "eckit/mpi/Comm.h"
+#include "eckit/serialisation/Stream.h"
+
+#include "multio/message/Payload.h"
 
 namespace multio {
 namespace server {
@@ -25,41 +33,118 @@ class MpiBuffer {
 public:
     explicit MpiBuffer(size_t maxBufSize);
 
-    bool isFree();
-
-    BufferStatus status = BufferStatus::available;
+    std::atomic<BufferStatus> status{BufferStatus::available};
     eckit::mpi::Request request;
     eckit::Buffer content;
 };
 
-class MpiOutputStream : public eckit::ResizableMemoryStream {
+// Each buffer starts with its own length, so that a receive posted before the size of the incoming
+// buffer is known can still tell where the data ends.
+//
+// No buffer sent is longer than the largest buffer of the pool (multioMpiBufferSize), which is
+// what servers pre-post receives of; clients and servers must therefore agree on that size. Frames
+// that grow beyond it are sent as parts that each fit, which the receiver puts back together.
+//
+// Payloads are written raw, 8-byte aligned, rather than as eckit blobs, so that the receiving side
+// can hand out slices of the buffer instead of copying the data out of it
+
+// Where a part belongs in the frame it was cut from. Parts are marked in their length.
+struct FramePart {
+    uint64_t sender;
+    uint64_t frameSize;
+    uint64_t offset;
+};
+
+class MpiOutputStream : public eckit::Stream {
 public:
     MpiOutputStream(MpiBuffer& buf);
 
     bool canFitMessage(size_t sz);
-    bool shallFitMessage(size_t sz);
+
+    // Batching state, for the flush policy
+    void messageWritten();
+    size_t messageCount() const;
+    std::chrono::steady_clock::time_point opened() const;
+
+    void writePayload(const message::Payload& payload);
+
+    size_t position() const;
+    size_t bytesWritten() const;
+
+    // Records the length in the buffer's frame header; returns the number of bytes to send.
+    // `trailing` bytes, e.g. a payload copied separately, are to follow the buffer's contents.
+    size_t finalise(size_t trailing = 0);
 
     MpiBuffer& buffer() const;
 
+    // Writes, to `out`, the part of a frame that starts at `part.offset` and is at most `maxSize`
+    // bytes long with its header; returns how many bytes of `frame` it holds
+    static size_t writePart(const void* frame, const FramePart& part, size_t maxSize,
+                            std::vector<char>& out);
+
 private:
+    long write(const void* data, long len) override;
+    long read(void* data, long len) override;
+
     std::string name() const override;
 
+    void align();
+
     MpiBuffer& buf_;
+    size_t pos_ = 0;
+
+    size_t messageCount_ = 0;
+    std::chrono::steady_clock::time_point opened_;
 };
 
-class MpiInputStream : public eckit::ResizableMemoryStream {
+class MpiInputStream : public eckit::Stream {
 public:
-    MpiInputStream(MpiBuffer& buf, size_t sz);
+    using Release = std::function<void(MpiBuffer&)>;
 
-    MpiBuffer& buffer() const;
+    MpiInputStream(MpiBuffer& buf, size_t sz, Release release);
+
+    // Reads `sz` bytes of memory the stream does not own, e.g. a shared ring, and calls `release`
+    // when it is gone. Payloads are always copied out, so that the memory is released in order.
+    MpiInputStream(char* data, size_t sz, std::function<void()> release);
+
+    // Length recorded by the sender in the buffer's frame header
+    static size_t frameSize(const MpiBuffer& buf);
+
+    // As above, and whether the buffer holds a part, from the first eight bytes of the buffer
+    static size_t frameSize(uint64_t header);
+    static bool isPart(uint64_t header);
+
+    // Whether `buf` holds part of a frame; if so, fills in `part` and points `data` at its bytes
+    static bool readPart(const MpiBuffer& buf, FramePart& part, const char*& data, size_t& size);
+
+    // Zero-copy payloads share ownership of the buffer with this stream; the buffer is handed to
+    // `release` when both the stream and all the payloads sliced from it are gone
+    message::Payload readPayload(size_t sz, bool zeroCopy);
 
+    // Whether payloads may be read without copying
+    bool sliceable() const;
+
+    // Skips the next `sz` bytes, aligned like a payload, and returns where they are; only valid
+    // while the stream lives
+    const char* readBytes(size_t sz);
+
+    size_t position() const;
     size_t size() const;
 
 private:
+    long write(const void* data, long len) override;
+    long read(void* data, long len) override;
+
     std::string name() const override;
 
-    MpiBuffer& buf_;
+    void align();
+
+    char* data_;
     size_t size_;
+    size_t pos_ = 0;
+    bool sliceable_;
+
+    std::shared_ptr<void> lease_;
 };
 
 }  // namespace server
@@ -10,51 +10,78 @@
 
 #include "MpiTransport.h"
 
+#include <sched.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 
+#include "multio/multio_config.h"
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+#include <mpi.h>
+#endif
+
 #include "eckit/config/Resource.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/maths/Functions.h"
 #include "eckit/runtime/Main.h"
-#include "eckit/serialisation/MemoryStream.h"
 
+#include "multio/LibMultio.h"
 #include "multio/util/logfile_name.h"
 
 namespace multio {
 namespace server {
 
-namespace {
-Message decodeMessage(eckit::Stream& stream) {
-    unsigned t;
-    stream >> t;
+struct MpiTransport::PendingStep {
+    message::Metadata metadata;
+    std::vector<size_t> servers;
 
-    std::string src_grp;
-    stream >> src_grp;
-    size_t src_id;
-    stream >> src_id;
+    // This client's rank followed by how many messages it has sent to each server; on the first
+    // client, gathered from all clients
+    std::vector<unsigned long> counts;
+    std::vector<unsigned long> gathered;
 
-    std::string dest_grp;
-    stream >> dest_grp;
-    size_t dest_id;
-    stream >> dest_id;
+#ifdef MULTIO_HAVE_NATIVE_MPI
+    MPI_Request request;
+#endif
+};
 
-    std::string fieldId;
-    stream >> fieldId;
+namespace {
 
-    unsigned long sz;
-    stream >> sz;
+const size_t defaultBufferSize = 64 * 1024 * 1024;
+const size_t defaultPoolSize = 128;
+const size_t defaultMaxListenBackoff = 1000;  // microseconds
+const size_t defaultPrepostedReceives = 0;
+const size_t defaultCreditWindow = 0;  // No flow control
 
-    eckit::Buffer buffer(sz);
-    stream >> buffer;
+// How long receiving waits before saying that nothing has arrived, and then waits again
+const std::chrono::milliseconds idleReport{60 * 1000};
 
-    return Message{Message::Header{static_cast<Message::Tag>(t), MpiPeer{src_grp, src_id},
-                                MpiPeer{dest_grp, dest_id}, std::move(fieldId)},
-                std::move(buffer)};
+eckit::LocalConfiguration flushConfiguration(const eckit::Configuration& cfg) {
+    return cfg.has("flush") ? cfg.getSubConfiguration("flush") : eckit::LocalConfiguration{};
 }
 
-const size_t defaultBufferSize = 64 * 1024 * 1024;
-const size_t defaultPoolSize = 128;
+#ifdef MULTIO_HAVE_NATIVE_MPI
+// For the few calls that eckit::mpi does not wrap
+void mpi_call(int code, const char* call) {
+    if (code != MPI_SUCCESS) {
+        throw eckit::SeriousBug(std::string{"MpiTransport: "} + call + " failed with error " +
+                                    std::to_string(code),
+                                Here());
+    }
+}
+#endif
+
+void require_native_mpi(const std::string& what) {
+#ifndef MULTIO_HAVE_NATIVE_MPI
+    throw eckit::UserError("MpiTransport: " + what + " requires multio built with NATIVE_MPI", Here());
+#else
+    (void)what;
+#endif
+}
 
 }  // namespace
 
@@ -63,12 +90,41 @@ MpiTransport::MpiTransport(const eckit::Configuration& cfg) :
     local_{cfg.getString("group"), eckit::mpi::comm(cfg.getString("group").c_str()).rank()},
     pool_{eckit::Resource<size_t>("multioMpiPoolSize;$MULTIO_MPI_POOL_SIZE", defaultPoolSize),
           eckit::Resource<size_t>("multioMpiBufferSize;$MULTIO_MPI_BUFFER_SIZE", defaultBufferSize),
-          comm(), statistics_} {}
+          comm(), statistics_, FlushPolicyFactory::instance().build(flushConfiguration(cfg))},
+    flowControl_{cfg.getUnsigned("credit", eckit::Resource<size_t>(
+                                               "multioMpiCreditWindow;$MULTIO_MPI_CREDIT_WINDOW",
+                                               defaultCreditWindow)),
+                 comm(), statistics_},
+    codec_{cfg, statistics_},
+    maxListenBackoff_{eckit::Resource<size_t>(
+        "multioMpiMaxListenBackoff;$MULTIO_MPI_MAX_LISTEN_BACKOFF", defaultMaxListenBackoff)},
+    prepostedCount_{cfg.getUnsigned(
+        "preposted", eckit::Resource<size_t>("multioMpiPrepostedReceives;$MULTIO_MPI_PREPOSTED_RECEIVES",
+                                             defaultPrepostedReceives))},
+    gatherSteps_{cfg.getBool("gatherStepComplete",
+                             eckit::Resource<bool>(
+                                 "multioMpiGatherStepComplete;$MULTIO_MPI_GATHER_STEP_COMPLETE", false))} {
+    if (gatherSteps_) {
+        require_native_mpi("gatherStepComplete");
+    }
+
+    if (prepostedCount_ >= pool_.capacity()) {
+        throw eckit::UserError("MpiTransport: cannot pre-post " + std::to_string(prepostedCount_) +
+                                   " receives from a pool of " + std::to_string(pool_.capacity()) +
+                                   " buffers",
+                               Here());
+    }
+}
 
 MpiTransport::~MpiTransport() {
+    cancelPreposted();
+    streamQueue_.close();
+
     std::ofstream logFile{util::logfile_name(), std::ios_base::app};
-    logFile << "\n ** " << *this << "\n";
+    logFile << "\n ** " << *this << "\n    " << pool_ << "\n";
+    flowControl_.report(logFile);
     statistics_.report(logFile);
+    pool_.flushPolicy().report(logFile);
 }
 
 void MpiTransport::openConnections() {
@@ -79,12 +135,18 @@ void MpiTransport::openConnections() {
 }
 
 void MpiTransport::closeConnections() {
+    progressSteps(true);
+
     for (auto& server : createServerPeers()) {
         Message msg{Message::Header{Message::Tag::Close, local_, *server}};
         bufferedSend(msg);
-        pool_.sendBuffer(msg.destination(), static_cast<int>(msg.tag()));
+        pool_.flush(msg.destination(), static_cast<int>(msg.tag()));
     }
     pool_.waitAll();
+
+    if (flowControl_.enabled()) {
+        flowControl_.awaitClosed();
+    }
 }
 
 Message MpiTransport::receive() {
@@ -92,48 +154,95 @@ Message MpiTransport::receive() {
     eckit::AutoTiming timing{statistics_.timer_, statistics_.totReturnTiming_};
 
     do {
+        if (stepGate_.ready()) {
+            auto msg = stepGate_.release();
+            if (flowControl_.enabled()) {
+                flowControl_.received(msg);
+            }
+            return msg;
+        }
+
         while (not msgPack_.empty()) {
             eckit::AutoTiming retTiming{statistics_.timer_, statistics_.returnTiming_};
             auto msg = msgPack_.front();
             msgPack_.pop();
+
+            if (not stepGate_.arrived(msg)) {
+                continue;
+            }
+
+            if (flowControl_.enabled()) {
+                flowControl_.received(msg);
+            }
             return msg;
         }
 
-        if (auto strm = streamQueue_.front()) {
-            while (strm->position() < strm->size()) {
-                eckit::AutoTiming decodeTiming{statistics_.timer_, statistics_.decodeTiming_};
-                auto msg = decodeMessage(*strm);
-                msgPack_.push(msg);
+        if (stepGate_.ready()) {
+            continue;
+        }
+
+        auto strm = streamQueue_.front(idleReport);
+        if (not strm) {
+            if (streamQueue_.closed()) {
+                // End of stream: listening has stopped
+                return Message{};
             }
-            streamQueue_.pop();
+            eckit::Log::debug<LibMultio>() << *this << ": nothing received for "
+                                           << idleReport.count() << "ms" << std::endl;
+            continue;
+        }
+
+        // Messages keep their receive buffer out of the pool until they are released. Copy the
+        // payloads out instead when the pool is running low, so that actions holding on to
+        // messages cannot starve the listener.
+        auto zeroCopy = strm->sliceable() && (pool_.availableCount() * 4 > pool_.capacity());
+        while (strm->position() < strm->size()) {
+            eckit::AutoTiming decodeTiming{statistics_.timer_, statistics_.decodeTiming_};
+            auto msg = decodeMessage(*strm, zeroCopy);
+            msgPack_.push(msg);
         }
+        streamQueue_.pop();
 
     } while (true);
 }
 
 void MpiTransport::send(const Message& msg) {
+    progressSteps(false);
+
     auto msg_tag = static_cast<int>(msg.tag());
 
+    if (flowControl_.enabled()) {
+        flowControl_.acquire(msg,
+                             [this, &msg, msg_tag]() { pool_.flush(msg.destination(), msg_tag); });
+    }
+
     // TODO: find available buffer instead
     // Add 4K for header/footer etc. Should be plenty
-    eckit::Buffer buffer{eckit::round(msg.size(), 8) + 4096};
+    MpiBuffer buffer{eckit::round(msg.size(), 8) + 4096};
 
-    eckit::ResizableMemoryStream stream{buffer};
+    MpiOutputStream stream{buffer};
 
     encodeMessage(stream, msg);
 
     eckit::AutoTiming timing{statistics_.timer_, statistics_.sendTiming_};
 
-    auto sz = static_cast<size_t>(stream.bytesWritten());
+    auto sz = stream.finalise();
     auto dest = static_cast<int>(msg.destination().id());
-    eckit::mpi::comm(local_.group().c_str()).send<void>(buffer, sz, dest, msg_tag);
+    pool_.send(buffer.content, sz, dest, msg_tag);
 
     ++statistics_.sendCount_;
     statistics_.sendSize_ += sz;
 }
 
 void MpiTransport::bufferedSend(const Message& msg) {
+    progressSteps(false);
+
+    if (flowControl_.enabled()) {
+        flowControl_.acquire(
+            msg, [this, &msg]() { pool_.flush(msg.destination(), static_cast<int>(msg.tag())); });
+    }
     encodeMessage(pool_.getStream(msg), msg);
+    pool_.messageWritten(msg);
 }
 
 void MpiTransport::print(std::ostream& os) const {
@@ -145,14 +254,141 @@ Peer MpiTransport::localPeer() const {
 }
 
 void MpiTransport::listen() {
+    if (flowControl_.enabled()) {
+        flowControl_.grant();
+    }
+
+    if (prepostedCount_ != 0) {
+        listenPreposted();
+        return;
+    }
+
     auto status = probe();
     if(status.error()) {
+        backOff();
         return;
     }
-    auto& buf = pool_.findAvailableBuffer();
-    auto sz = blockingReceive(status, buf);
-    eckit::AutoTiming timing{statistics_.timer_, statistics_.pushToQueueTiming_};
-    streamQueue_.emplace(buf, sz);
+    listenBackoff_ = 0;
+
+    auto sz = comm().getCount<void>(status);
+    pool_.adapt(sz);
+
+    auto& buf = pool_.findAvailableBuffer(sz);
+    blockingReceive(status, buf, sz);
+    received(buf, sz);
+}
+
+void MpiTransport::stopListening() {
+    if (flowControl_.enabled()) {
+        flowControl_.finish();
+    }
+    cancelPreposted();
+    streamQueue_.close();
+}
+
+void MpiTransport::consumed(const Message& msg) {
+    if (flowControl_.enabled()) {
+        flowControl_.consumed(msg);
+    }
+}
+
+std::vector<ServerLoad> MpiTransport::serverLoads(const PeerList& servers) {
+    std::vector<ServerLoad> loads(servers.size());
+    if (not flowControl_.enabled()) {
+        return loads;
+    }
+
+    std::vector<double> words;
+    for (const auto& server : servers) {
+        auto load = flowControl_.load(static_cast<int>(server->id()));
+        words.push_back(static_cast<double>(load.backlog));
+        words.push_back(load.lag);
+    }
+
+    // Every client hears from the servers at different times
+    clientComm().broadcast(std::begin(words), std::end(words), 0);
+
+    for (auto ii = 0ul; ii != loads.size(); ++ii) {
+        loads[ii].backlog = static_cast<size_t>(words[2 * ii]);
+        loads[ii].lag = words[2 * ii + 1];
+    }
+    return loads;
+}
+
+const eckit::mpi::Comm& MpiTransport::clientComm() {
+    return client_comm(local_.group(), createServerPeers());
+}
+
+void MpiTransport::listenPreposted() {
+    // Receives match incoming buffers in the order they were posted, and MPI does not reorder
+    // buffers from the same sender, so completing them oldest first preserves each client's order
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    while (posted_.size() < prepostedCount_) {
+        postReceive();
+    }
+
+    bool completed = false;
+    {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.probeTiming_};
+        completed = posted_.front()->request.test();
+    }
+    if (not completed) {
+        backOff();
+        return;
+    }
+    listenBackoff_ = 0;
+
+    auto& buf = *posted_.front();
+    posted_.pop_front();
+
+    auto sz = MpiInputStream::frameSize(buf);
+    ASSERT(sz <= buf.content.size());
+
+    ++statistics_.receiveCount_;
+    statistics_.receiveSize_ += sz;
+
+    received(buf, sz);
+}
+
+void MpiTransport::postReceive() {
+    // The size of the incoming buffer is not known yet, but senders split anything larger
+    auto& buf = pool_.findAvailableBuffer(pool_.maxBufferSize());
+    buf.request = comm().iReceive<void>(buf.content, buf.content.size(), comm().anySource(),
+                                        comm().anyTag());
+    buf.status = BufferStatus::transmitting;
+    posted_.push_back(&buf);
+}
+
+void MpiTransport::cancelPreposted() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto buf : posted_) {
+#ifdef MULTIO_HAVE_NATIVE_MPI
+        auto request = MPI_Request_f2c(buf->request.request());
+        mpi_call(MPI_Cancel(&request), "MPI_Cancel");
+        mpi_call(MPI_Wait(&request, MPI_STATUS_IGNORE), "MPI_Wait");
+#else
+        // Every client has closed, so an empty message to self matches the oldest receive
+        const char nothing = 0;
+        comm().send<void>(&nothing, 0, static_cast<int>(comm().rank()), 0);
+        comm().wait(buf->request);
+#endif
+        pool_.release(*buf);
+    }
+    posted_.clear();
+}
+
+void MpiTransport::backOff() {
+    // Yield first, then sleep for exponentially longer up to the maximum, so that an idle server
+    // does not keep a core busy probing while a busy one still picks up messages promptly
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.idleTiming_};
+    if (listenBackoff_ == 0) {
+        ::sched_yield();
+        listenBackoff_ = 1;
+        return;
+    }
+    ::usleep(static_cast<useconds_t>(listenBackoff_));
+    listenBackoff_ = std::min(2 * listenBackoff_, maxListenBackoff_);
 }
 
 PeerList MpiTransport::createServerPeers() {
@@ -181,23 +417,229 @@ eckit::mpi::Status MpiTransport::probe() {
     return status;
 }
 
-size_t MpiTransport::blockingReceive(eckit::mpi::Status& status, MpiBuffer& buffer) {
-    auto sz = comm().getCount<void>(status);
-    ASSERT(sz < buffer.content.size());
+void MpiTransport::blockingReceive(eckit::mpi::Status& status, MpiBuffer& buffer, size_t sz) {
+    ASSERT(sz <= buffer.content.size());
 
     eckit::AutoTiming timing{statistics_.timer_, statistics_.receiveTiming_};
     comm().receive<void>(buffer.content, sz, status.source(), status.tag());
+    ASSERT(MpiInputStream::frameSize(buffer) == sz);
 
     ++statistics_.receiveCount_;
     statistics_.receiveSize_ += sz;
+}
+
+void MpiTransport::received(MpiBuffer& buffer, size_t sz) {
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.pushToQueueTiming_};
 
-    return sz;
+    FramePart part;
+    const char* data = nullptr;
+    size_t partSize = 0;
+    if (not MpiInputStream::readPart(buffer, part, data, partSize)) {
+        streamQueue_.emplace(buffer, sz, [this](MpiBuffer& released) { pool_.release(released); });
+        return;
+    }
+
+    // A sender's parts arrive in order and before anything else it sends
+    auto it = assembling_.find(part.sender);
+    if (it == std::end(assembling_)) {
+        ASSERT(part.offset == 0);
+        auto& frame = pool_.findAvailableBuffer(static_cast<size_t>(part.frameSize));
+        it = assembling_.emplace(part.sender, &frame).first;
+    }
+
+    auto& frame = *it->second;
+    std::memcpy(static_cast<char*>(frame.content.data()) + part.offset, data, partSize);
+    pool_.release(buffer);
+
+    if (part.offset + partSize == part.frameSize) {
+        assembling_.erase(it);
+        ASSERT(MpiInputStream::frameSize(frame) == part.frameSize);
+        streamQueue_.emplace(frame, static_cast<size_t>(part.frameSize),
+                             [this](MpiBuffer& released) { pool_.release(released); });
+    }
 }
 
-void MpiTransport::encodeMessage(eckit::Stream& strm, const Message& msg) {
+void MpiTransport::encodeMessage(MpiOutputStream& strm, const Message& msg) {
     eckit::AutoTiming timing{statistics_.timer_, statistics_.encodeTiming_};
 
-    msg.encode(strm);
+    countSent(msg);
+
+    msg.header().encode(strm);
+
+    auto encoded = codec_.encode(msg);
+    strm << encoded.flags;
+    if (encoded.flags != PayloadCodec::raw) {
+        strm << static_cast<unsigned long>(msg.size());
+    }
+
+    strm << static_cast<unsigned long>(encoded.size);
+    strm.writePayload(message::Payload::borrow(encoded.data, encoded.size));
+}
+
+Message MpiTransport::decodeMessage(MpiInputStream& strm, bool zeroCopy) {
+    auto header = Message::Header::decode(strm);
+
+    unsigned char flags;
+    strm >> flags;
+
+    unsigned long rawSize = 0;
+    if (flags != PayloadCodec::raw) {
+        strm >> rawSize;
+    }
+
+    unsigned long sz;
+    strm >> sz;
+
+    if (flags != PayloadCodec::raw) {
+        // Decompressed straight out of the receive buffer
+        auto encoded = strm.readBytes(sz);
+        return Message{std::move(header), codec_.decode(flags, encoded, sz, rawSize)};
+    }
+
+    if (zeroCopy) {
+        ++statistics_.zeroCopyCount_;
+    }
+    else {
+        ++statistics_.payloadCopyCount_;
+    }
+
+    return Message{std::move(header), strm.readPayload(sz, zeroCopy)};
+}
+
+void MpiTransport::countSent(const Message& msg) {
+    if (not StepGate::gathered(msg)) {
+        ++sentCounts_[msg.destination().id()];
+    }
+}
+
+void MpiTransport::sendStepComplete(const message::Metadata& md, const PeerList& servers) {
+    if (not gatherSteps_) {
+        Transport::sendStepComplete(md, servers);
+        return;
+    }
+
+    // Data still buffered would hold the step up on the servers
+    for (auto& server : servers) {
+        flushTo(*server);
+    }
+
+    std::unique_ptr<PendingStep> step{new PendingStep};
+    step->metadata = md;
+    step->counts.push_back(local_.id());
+    for (auto& server : servers) {
+        step->servers.push_back(server->id());
+        step->counts.push_back(sentCounts_[server->id()]);
+    }
+
+    const auto& clients = clientComm();
+    if (clients.rank() == 0) {
+        step->gathered.resize(step->counts.size() * clients.size());
+    }
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+    auto width = static_cast<int>(step->counts.size());
+    mpi_call(MPI_Igather(step->counts.data(), width, MPI_UNSIGNED_LONG, step->gathered.data(),
+                         width, MPI_UNSIGNED_LONG, 0, MPI_Comm_f2c(clients.communicator()),
+                         &step->request),
+             "MPI_Igather");
+#endif
+
+    pendingSteps_.push_back(std::move(step));
+    progressSteps(false);
+}
+
+void MpiTransport::progressSteps(bool wait) {
+    // Announcing a step sends messages, which come back here
+    if (progressing_) {
+        return;
+    }
+    progressing_ = true;
+
+    // Steps are announced in order
+    while (not pendingSteps_.empty()) {
+        auto& step = *pendingSteps_.front();
+
+        int done = 1;
+#ifdef MULTIO_HAVE_NATIVE_MPI
+        if (wait) {
+            mpi_call(MPI_Wait(&step.request, MPI_STATUS_IGNORE), "MPI_Wait");
+        }
+        else {
+            mpi_call(MPI_Test(&step.request, &done, MPI_STATUS_IGNORE), "MPI_Test");
+        }
+#endif
+        if (not done) {
+            break;
+        }
+
+        if (not step.gathered.empty()) {
+            sendGatheredStep(step);
+        }
+        pendingSteps_.pop_front();
+    }
+
+    progressing_ = false;
+}
+
+void MpiTransport::sendGatheredStep(const PendingStep& step) {
+    auto width = step.counts.size();
+    auto clientCount = step.gathered.size() / width;
+
+    for (auto ii = 0ul; ii != step.servers.size(); ++ii) {
+        // Pairs of client rank and how many messages the server must have had from that client
+        std::vector<unsigned long> expected;
+        for (auto client = 0ul; client != clientCount; ++client) {
+            expected.push_back(step.gathered[client * width]);
+            expected.push_back(step.gathered[client * width + 1 + ii]);
+        }
+
+        message::Metadata md{step.metadata};
+        md.set("flushCount", clientCount);
+
+        MpiPeer server{local_.group(), step.servers[ii]};
+        Message msg{Message::Header{Message::Tag::StepComplete, local_, server, std::move(md)},
+                    StepGate::expectation(expected)};
+        bufferedSend(msg);
+        flushTo(server);
+    }
+}
+
+void MpiTransport::flushTo(const Peer& server) {
+    pool_.flush(server, static_cast<int>(Message::Tag::StepComplete));
+}
+
+const eckit::mpi::Comm& client_comm(const std::string& group, const PeerList& servers) {
+    auto name = group + "-clients";
+    if (eckit::mpi::hasComm(name.c_str())) {
+        return eckit::mpi::comm(name.c_str());
+    }
+
+    require_native_mpi("a communicator of the clients");
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+    // Only the clients take part, so this cannot be a split of the whole group
+    std::vector<int> ranks;
+    for (const auto& server : servers) {
+        ranks.push_back(static_cast<int>(server->id()));
+    }
+
+    auto parent = MPI_Comm_f2c(eckit::mpi::comm(group.c_str()).communicator());
+    MPI_Group all;
+    MPI_Group clients;
+    mpi_call(MPI_Comm_group(parent, &all), "MPI_Comm_group");
+    mpi_call(MPI_Group_excl(all, static_cast<int>(ranks.size()), ranks.data(), &clients),
+             "MPI_Group_excl");
+
+    MPI_Comm created;
+    mpi_call(MPI_Comm_create_group(parent, clients, 0, &created), "MPI_Comm_create_group");
+    MPI_Group_free(&clients);
+    MPI_Group_free(&all);
+
+    eckit::mpi::addComm(name.c_str(), MPI_Comm_c2f(created));
+#else
+    (void)servers;
+#endif
+    return eckit::mpi::comm(name.c_str());
 }
 
 static TransportBuilder<MpiTransport> MpiTransportBuilder("mpi");
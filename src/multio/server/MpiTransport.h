@@ -17,26 +17,30 @@
 #ifndef multio_server_MpiTransport_H
 #define multio_server_MpiTransport_H
 
+#include <deque>
+#include <map>
+#include <memory>
 #include <queue>
 
-#include "eckit/io/Buffer.h"
 #include "eckit/log/Statistics.h"
 #include "eckit/mpi/Comm.h"
-#include "eckit/serialisation/ResizableMemoryStream.h"
 
 #include "multio/server/Transport.h"
+#include "multio/server/FlowControl.h"
+#include "multio/server/PayloadCodec.h"
+#include "multio/server/StepGate.h"
 #include "multio/server/StreamPool.h"
 #include "multio/server/StreamQueue.h"
 
 namespace multio {
 namespace server {
 
-class MpiTransport final : public Transport {
+class MpiTransport : public Transport {
 public:
     MpiTransport(const eckit::Configuration& config);
     ~MpiTransport();
 
-private:
+protected:
     void openConnections() override;
     void closeConnections() override;
 
@@ -52,25 +56,83 @@ private:
 
     void listen() override;
 
+    void stopListening() override;
+
+    void consumed(const Message& msg) override;
+
+    std::vector<ServerLoad> serverLoads(const PeerList& servers) override;
+
+    void sendStepComplete(const message::Metadata& md, const PeerList& servers) override;
+
     PeerList createServerPeers() override;
 
     const eckit::mpi::Comm& comm() const;
 
+    // Clients only; created on first use
+    const eckit::mpi::Comm& clientComm();
+
     eckit::mpi::Status probe();
-    size_t blockingReceive(eckit::mpi::Status& status, MpiBuffer& buffer);
+    void backOff();
+
+    void listenPreposted();
+    void postReceive();
+
+    // Receives still posted when listening stops are cancelled, or completed by messages to self,
+    // before their buffers go back to the pool
+    void cancelPreposted();
+    void blockingReceive(eckit::mpi::Status& status, MpiBuffer& buffer, size_t sz);
+
+    // Queues a received buffer for decoding, or adds it to the frame it is part of
+    void received(MpiBuffer& buffer, size_t sz);
+
+    void encodeMessage(MpiOutputStream& strm, const Message& msg);
+    Message decodeMessage(MpiInputStream& strm, bool zeroCopy);
 
-    void encodeMessage(eckit::Stream& strm, const Message& msg);
+    // Gathered step completion: instead of every client telling every server, the first client
+    // gathers how many messages each client has sent to each server so far and tells each server
+    // once. Servers hold that message back until they have received as many from every client.
+    struct PendingStep;
+    void countSent(const Message& msg);
+    void progressSteps(bool wait);
+    void sendGatheredStep(const PendingStep& step);
+
+    // Sends whatever is buffered for `server`
+    virtual void flushTo(const Peer& server);
 
     MpiPeer local_;
 
     StreamPool pool_;
 
+    FlowControl flowControl_;
+
+    PayloadCodec codec_;
+
     StreamQueue streamQueue_;
     std::queue<Message> msgPack_;
 
+    const size_t maxListenBackoff_;
+    size_t listenBackoff_ = 0;
+
+    // Receives posted ahead of the incoming buffers, oldest first; empty when probing instead
+    const size_t prepostedCount_;
+    std::deque<MpiBuffer*> posted_;
+
+    // Frames arriving in parts, by sender
+    std::map<uint64_t, MpiBuffer*> assembling_;
+
+    const bool gatherSteps_;
+    std::deque<std::unique_ptr<PendingStep>> pendingSteps_;
+    std::map<size_t, unsigned long> sentCounts_;
+    StepGate stepGate_;
+    bool progressing_ = false;
+
     std::mutex mutex_;
 };
 
+// The communicator of all ranks of `group` but the servers. Created on first use, which is
+// collective over the clients.
+const eckit::mpi::Comm& client_comm(const std::string& group, const PeerList& servers);
+
 }  // namespace server
 }  // namespace multio
 
@@ -9,8 +9,11 @@
 
 #include "multio/LibMultio.h"
 #include "multio/message/Message.h"
+#include "multio/server/DynamicPlacement.h"
 #include "multio/server/MpiTransport.h"
+#include "multio/server/NodeAggregator.h"
 #include "multio/server/TcpTransport.h"
+#include "multio/server/WeightedPlacement.h"
 
 using multio::message::Peer;
 
@@ -28,6 +31,22 @@ MultioClient::MultioClient(const eckit::Configuration& config) :
     counters_(serverPeers_.size()),
     distType_{distributionType()} {
     eckit::Log::debug<multio::LibMultio>() << config << std::endl;
+
+    if (distType_ == DistributionType::weighted) {
+        weighted_.reset(new WeightedPlacement{config, serverPeers_.size()});
+    }
+    if (distType_ == DistributionType::dynamic) {
+        dynamic_.reset(new DynamicPlacement{config, serverPeers_.size()});
+    }
+
+    if (config.getBool("nodeAggregation", false)) {
+        // Only the node leaders send, so the servers cannot count the messages of every client
+        if (config.getBool("gatherStepComplete", false)) {
+            throw eckit::UserError(
+                "MultioClient: nodeAggregation cannot be combined with gatherStepComplete", Here());
+        }
+        nodeAggregator_.reset(new NodeAggregator{config.getString("group"), serverPeers_});
+    }
 }
 
 MultioClient::~MultioClient() = default;
@@ -40,57 +59,70 @@ void MultioClient::closeConnections() const {
     transport_->closeConnections();
 }
 
-void MultioClient::sendDomain(message::Metadata metadata, eckit::Buffer&& domain) {
+void MultioClient::sendDomain(message::Metadata metadata, message::Payload domain) {
+    if (nodeAggregator_ && not nodeAggregator_->domain(metadata, domain)) {
+        return;
+    }
+
     for (auto& server : serverPeers_) {
-        Message msg{Message::Header{Message::Tag::Domain, client_, *server, std::move(metadata)},
+        Message msg{Message::Header{Message::Tag::Domain, client_, *server,
+                                    message::Metadata{metadata}},
                     domain};
 
         transport_->bufferedSend(msg);
     }
 }
 
-void MultioClient::sendField(message::Metadata metadata, eckit::Buffer&& field,
+void MultioClient::sendField(message::Metadata metadata, message::Payload field,
                              bool to_all_servers) {
+    const message::FieldKey key{metadata};
 
     if (to_all_servers) {
+        if (nodeAggregator_ && not nodeAggregator_->field(metadata, field)) {
+            return;
+        }
+
         for (auto& server : serverPeers_) {
-            Message msg{Message::Header{Message::Tag::Field, client_, *server, std::move(metadata)},
+            Message msg{Message::Header{Message::Tag::Field, client_, *server,
+                                        message::Metadata{metadata}, key},
                         field};
 
             transport_->bufferedSend(msg);
         }
     }
     else {
-        auto server = chooseServer(metadata);
-
-//        eckit::Log::info() << " *** Server " << server << " is picked for field "
-//                           << message::to_string(metadata) << std::endl;
+        // Chosen on every client, as some distributions need all clients to take part
+        auto server = chooseServer(metadata, key);
+        if (nodeAggregator_ && not nodeAggregator_->field(metadata, field)) {
+            return;
+        }
 
-        Message msg{
-            Message::Header{Message::Tag::Field, client_, server, std::move(metadata)},
-            std::move(field)};
+        Message msg{Message::Header{Message::Tag::Field, client_, server, std::move(metadata), key},
+                    std::move(field)};
 
         transport_->bufferedSend(msg);
     }
 }
 
 void MultioClient::sendStepComplete() const {
-    for (auto& server : serverPeers_) {
-        Message msg{Message::Header{Message::Tag::StepComplete, client_, *server}};
-        transport_->bufferedSend(msg);
+    // Collective over all clients, so taken before the node leaders go their own way
+    if (dynamic_) {
+        dynamic_->update(transport_->serverLoads(serverPeers_));
     }
+
+    if (nodeAggregator_ && not nodeAggregator_->leader()) {
+        return;
+    }
+    transport_->sendStepComplete(message::Metadata{}, serverPeers_);
 }
 
-message::Peer MultioClient::chooseServer(const message::Metadata& metadata) {
+message::Peer MultioClient::chooseServer(const message::Metadata& metadata,
+                                         const message::FieldKey& key) {
     switch (distType_) {
         case DistributionType::hashed_cyclic: {
-            std::ostringstream os;
-            os << metadata.getString("category") << metadata.getString("nemoParam")
-               << metadata.getString("param") << metadata.getLong("level");
-
             ASSERT(usedServerCount_ <= serverCount_);
 
-            auto offset = std::hash<std::string>{}(os.str()) % usedServerCount_;
+            auto offset = key.field() % usedServerCount_;
             auto id = (serverId_ + offset) % serverCount_;
 
             ASSERT(id < serverPeers_.size());
@@ -98,27 +130,20 @@ message::Peer MultioClient::chooseServer(const message::Metadata& metadata) {
             return *serverPeers_[id];
         }
         case DistributionType::hashed_to_single: {
-            std::ostringstream os;
-            os << metadata.getString("category") << metadata.getString("nemoParam")
-               << metadata.getString("param") << metadata.getLong("level");
-
-            auto id = std::hash<std::string>{}(os.str()) % serverCount_;
+            auto id = key.field() % serverCount_;
 
             ASSERT(id < serverPeers_.size());
 
             return *serverPeers_[id];
         }
         case DistributionType::even: {
-            std::ostringstream os;
-            os << metadata.getString("category") << metadata.getString("nemoParam")
-               << metadata.getString("param") << metadata.getLong("level");
-
-            if (destinations_.find(os.str()) != end(destinations_)) {
-                return destinations_.at(os.str());
+            auto it = destinations_.find(key.field());
+            if (it != end(destinations_)) {
+                return it->second;
             }
 
-            auto it = std::min_element(begin(counters_), end(counters_));
-            auto id = static_cast<size_t>(std::distance(std::begin(counters_), it));
+            auto cit = std::min_element(begin(counters_), end(counters_));
+            auto id = static_cast<size_t>(std::distance(std::begin(counters_), cit));
 
             ASSERT(id < serverPeers_.size());
             ASSERT(id < counters_.size());
@@ -126,10 +151,24 @@ message::Peer MultioClient::chooseServer(const message::Metadata& metadata) {
             ++counters_[id];
 
             auto dest = *serverPeers_[id];
-            destinations_[os.str()] = *serverPeers_[id];
+            destinations_.emplace(key.field(), dest);
 
             return dest;
         }
+        case DistributionType::dynamic: {
+            auto id = dynamic_->place(metadata);
+
+            ASSERT(id < serverPeers_.size());
+
+            return *serverPeers_[id];
+        }
+        case DistributionType::weighted: {
+            auto id = weighted_->place(metadata);
+
+            ASSERT(id < serverPeers_.size());
+
+            return *serverPeers_[id];
+        }
         default:
             throw eckit::SeriousBug("Unhandled distribution type");
     }
@@ -139,7 +178,9 @@ MultioClient::DistributionType MultioClient::distributionType() {
     const std::map<std::string, enum DistributionType> str2dist = {
         {"hashed_cyclic", DistributionType::hashed_cyclic},
         {"hashed_to_single", DistributionType::hashed_to_single},
-        {"even", DistributionType::even}};
+        {"even", DistributionType::even},
+        {"dynamic", DistributionType::dynamic},
+        {"weighted", DistributionType::weighted}};
 
     auto key = std::getenv("MULTIO_SERVER_DISTRIBUTION");
     return key ? str2dist.at(key) : DistributionType::hashed_to_single;
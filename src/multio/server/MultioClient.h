@@ -14,12 +14,14 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <string>
 
+#include "multio/message/FieldKey.h"
 #include "multio/message/Metadata.h"
+#include "multio/message/Payload.h"
 #include "multio/message/Peer.h"
 
 namespace eckit {
-class Buffer;
 class Configuration;
 }  // namespace eckit
 
@@ -27,7 +29,10 @@ namespace multio {
 
 namespace server {
 
+class DynamicPlacement;
+class NodeAggregator;
 class Transport;
+class WeightedPlacement;
 
 class MultioClient {
 public:
@@ -39,9 +44,11 @@ public:
 
     void closeConnections() const;
 
-    void sendDomain(message::Metadata metadata, eckit::Buffer&& domain);
+    // Payloads may be borrowed: they are serialised before these calls return, after which the
+    // caller may reuse the memory
+    void sendDomain(message::Metadata metadata, message::Payload domain);
 
-    void sendField(message::Metadata metadata, eckit::Buffer&& field, bool to_all_servers = false);
+    void sendField(message::Metadata metadata, message::Payload field, bool to_all_servers = false);
 
     void sendStepComplete() const;
 
@@ -60,8 +67,8 @@ private:
     PeerList serverPeers_;
 
     // Distribute fields
-    message::Peer chooseServer(const message::Metadata& metadata);
-    std::map<std::string, message::Peer> destinations_;
+    message::Peer chooseServer(const message::Metadata& metadata, const message::FieldKey& key);
+    std::map<std::uint64_t, message::Peer> destinations_;
     std::vector<u_int64_t> counters_;
 
     enum class DistributionType : unsigned
@@ -69,10 +76,18 @@ private:
         hashed_cyclic,
         hashed_to_single,
         even,
+        dynamic,
+        weighted,
     };
     DistributionType distType_;
 
+    std::unique_ptr<WeightedPlacement> weighted_;
+    std::unique_ptr<DynamicPlacement> dynamic_;
+
     enum DistributionType distributionType();
+
+    // Merges the partitions of the clients on a node before sending, if enabled
+    std::unique_ptr<NodeAggregator> nodeAggregator_;
 };
 
 }  // namespace server
@@ -20,6 +20,7 @@
 #include <set>
 #include <typeinfo>
 
+#include "eckit/config/LocalConfiguration.h"
 #include "eckit/config/YAMLConfiguration.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/log/Log.h"
@@ -35,6 +36,7 @@
 #include "multio/util/print_buffer.h"
 
 using multio::message::Metadata;
+using multio::message::Payload;
 using multio::util::print_buffer;
 using multio::server::MultioClient;
 using multio::server::MultioServer;
@@ -128,7 +130,7 @@ public:
     }
 
     void setDomain(const std::string& dname, const int* data, size_t bytes) {
-        eckit::Buffer domain_def{reinterpret_cast<const char*>(data), bytes};
+        auto domain_def = Payload::borrow(data, bytes);
         Metadata md;
         md.set("name", dname);
         md.set("category", "structured");
@@ -151,7 +153,8 @@ public:
         metadata_.set("domainCount", clientCount_);
         metadata_.set("domain", paramMap_.get(fname).gridType);
 
-        eckit::Buffer field_vals{reinterpret_cast<const char*>(data), bytes};
+        // The field is serialised straight from the model array, which may be reused on return
+        auto field_vals = Payload::borrow(data, bytes);
 
         MultioNemo::instance().client().sendField(metadata_, std::move(field_vals), to_all_servers);
     }
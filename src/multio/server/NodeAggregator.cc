@@ -0,0 +1,229 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "NodeAggregator.h"
+
+#include <cstring>
+#include <limits>
+
+#include "multio/multio_config.h"
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+#include <mpi.h>
+#endif
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/mpi/Comm.h"
+
+#include "multio/LibMultio.h"
+#include "multio/domain/Domain.h"
+#include "multio/message/BufferPool.h"
+#include "multio/server/MpiTransport.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+void mpi_call(int code, const char* call) {
+    if (code != MPI_SUCCESS) {
+        throw eckit::SeriousBug(std::string{"NodeAggregator: "} + call + " failed with error " +
+                                    std::to_string(code),
+                                Here());
+    }
+}
+#endif
+
+}  // namespace
+
+NodeAggregator::NodeAggregator(const std::string& group, const PeerList& servers) {
+    if (not eckit::mpi::hasComm(group.c_str())) {
+        throw eckit::UserError("NodeAggregator: node aggregation requires the MPI communicator '" +
+                                   group + "'",
+                               Here());
+    }
+
+#ifdef MULTIO_HAVE_NATIVE_MPI
+    const auto& clients = client_comm(group, servers);
+    auto parent = MPI_Comm_f2c(clients.communicator());
+
+    MPI_Comm node;
+    mpi_call(MPI_Comm_split_type(parent, MPI_COMM_TYPE_SHARED, static_cast<int>(clients.rank()),
+                                 MPI_INFO_NULL, &node),
+             "MPI_Comm_split_type");
+    comm_ = MPI_Comm_c2f(node);
+    mpi_call(MPI_Comm_rank(node, &rank_), "MPI_Comm_rank");
+
+    unsigned long leaders = leader() ? 1 : 0;
+    unsigned long count = 0;
+    mpi_call(MPI_Allreduce(&leaders, &count, 1, MPI_UNSIGNED_LONG, MPI_SUM, parent),
+             "MPI_Allreduce");
+    nodeCount_ = count;
+
+    int size;
+    mpi_call(MPI_Comm_size(node, &size), "MPI_Comm_size");
+    eckit::Log::debug<LibMultio>() << "NodeAggregator: " << size << " clients on this node, "
+                                   << nodeCount_ << " nodes in total" << std::endl;
+#else
+    (void)servers;
+    throw eckit::UserError("NodeAggregator: node aggregation requires multio built with NATIVE_MPI",
+                           Here());
+#endif
+}
+
+bool NodeAggregator::domain(message::Metadata& md, message::Payload& payload) {
+    domains_.insert(md.getString("name"));
+
+    std::vector<size_t> sizes;
+    auto data = gather(payload.data(), payload.size(), sizes);
+    if (not leader()) {
+        return false;
+    }
+
+    // Halo points are dropped, so that every point of the merged domain belongs to it
+    auto category = md.getString("category");
+    Layout layout;
+    std::vector<int32_t> combined;
+    size_t offset = 0;
+    for (auto size : sizes) {
+        ASSERT(size % sizeof(int32_t) == 0);
+        std::vector<int32_t> def(size / sizeof(int32_t));
+        std::memcpy(def.data(), data.data() + offset, size);
+        offset += size;
+
+        auto indices = domain::make_domain(category, std::move(def))->global_indices();
+
+        std::vector<int32_t> owned;
+        for (size_t ii = 0; ii != indices.size(); ++ii) {
+            if (indices[ii] >= 0) {
+                owned.push_back(static_cast<int32_t>(ii));
+                combined.push_back(indices[ii]);
+            }
+        }
+        layout.localSizes.push_back(indices.size());
+        layout.owned.push_back(std::move(owned));
+    }
+    layouts_[md.getString("name")] = std::move(layout);
+
+    md.set("category", "unstructured");
+    md.set("domainCount", nodeCount_);
+
+    payload = message::BufferPool::instance().allocate(combined.size() * sizeof(int32_t));
+    std::memcpy(payload.data(), combined.data(), payload.size());
+
+    return true;
+}
+
+bool NodeAggregator::field(message::Metadata& md, message::Payload& payload) {
+    auto levelCount = static_cast<size_t>(md.getLong("levelCount", 1));
+    ASSERT(payload.size() % levelCount == 0);
+    auto levelSize = payload.size() / levelCount;
+
+    // Checked on every client of the node, so that none is left waiting in a gather
+    auto domain = md.getString("domain");
+    if (domains_.find(domain) == end(domains_)) {
+        throw eckit::SeriousBug(
+            "NodeAggregator: no domain '" + domain + "' was sent before the field", Here());
+    }
+
+    const Layout* layout = nullptr;
+    message::Payload merged;
+    if (leader()) {
+        layout = &layouts_.at(domain);
+
+        size_t count = 0;
+        for (const auto& owned : layout->owned) {
+            count += owned.size();
+        }
+        merged = message::BufferPool::instance().allocate(count * levelCount * sizeof(double));
+    }
+
+    // One level at a time, as a whole node's field may not fit the int counts of MPI_Gatherv
+    auto local = static_cast<const char*>(payload.data());
+    auto out = static_cast<double*>(merged.data());
+    std::vector<size_t> sizes;
+    for (size_t lev = 0; lev != levelCount; ++lev) {
+        auto data = gather(local + lev * levelSize, levelSize, sizes);
+        if (not leader()) {
+            continue;
+        }
+
+        ASSERT(sizes.size() == layout->owned.size());
+        size_t offset = 0;
+        for (size_t rank = 0; rank != sizes.size(); ++rank) {
+            ASSERT(sizes[rank] == layout->localSizes[rank] * sizeof(double));
+            auto values = reinterpret_cast<const double*>(data.data() + offset);
+            for (auto idx : layout->owned[rank]) {
+                *out++ = values[idx];
+            }
+            offset += sizes[rank];
+        }
+    }
+
+    if (not leader()) {
+        return false;
+    }
+
+    payload = std::move(merged);
+    md.set("domainCount", nodeCount_);
+
+    return true;
+}
+
+std::vector<char> NodeAggregator::gather(const void* local, size_t size,
+                                         std::vector<size_t>& sizes) const {
+#ifdef MULTIO_HAVE_NATIVE_MPI
+    auto comm = MPI_Comm_f2c(comm_);
+
+    int count;
+    mpi_call(MPI_Comm_size(comm, &count), "MPI_Comm_size");
+
+    // All clients learn the sizes, so that they all fail alike if the total is too large
+    unsigned long sz = size;
+    std::vector<unsigned long> all(count);
+    mpi_call(MPI_Allgather(&sz, 1, MPI_UNSIGNED_LONG, all.data(), 1, MPI_UNSIGNED_LONG, comm),
+             "MPI_Allgather");
+
+    std::vector<int> counts;
+    std::vector<int> displs;
+    size_t total = 0;
+    for (auto part : all) {
+        counts.push_back(static_cast<int>(part));
+        displs.push_back(static_cast<int>(total));
+        total += part;
+    }
+    if (total > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw eckit::SeriousBug("NodeAggregator: " + std::to_string(total) +
+                                    " bytes are too many to gather at once",
+                                Here());
+    }
+
+    std::vector<char> data;
+    if (leader()) {
+        sizes.assign(begin(all), end(all));
+        data.resize(total);
+    }
+
+    mpi_call(MPI_Gatherv(local, static_cast<int>(sz), MPI_BYTE, data.data(), counts.data(),
+                         displs.data(), MPI_BYTE, 0, comm),
+             "MPI_Gatherv");
+
+    return data;
+#else
+    (void)local;
+    (void)size;
+    (void)sizes;
+    NOTIMP;
+#endif
+}
+
+}  // namespace server
+}  // namespace multio
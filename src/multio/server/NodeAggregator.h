@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_NodeAggregator_H
+#define multio_server_NodeAggregator_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "eckit/memory/NonCopyable.h"
+
+#include "multio/message/Metadata.h"
+#include "multio/message/Payload.h"
+#include "multio/server/Transport.h"
+
+namespace multio {
+namespace server {
+
+// Optional client-side stage that merges the partitions of all clients on a node before they are
+// sent, so that servers receive one part of every field per node rather than one per client. The
+// clients of a node hand their domains and fields to the first of them, the node leader, which
+// combines the domains into a single unstructured one and lays out the field values to match.
+//
+// Every call is collective over the clients of a node. Like the rest of the client, this relies on
+// all clients sending the same domains and fields in the same order.
+
+class NodeAggregator : private eckit::NonCopyable {
+public:
+    NodeAggregator(const std::string& group, const PeerList& servers);
+
+    bool leader() const { return rank_ == 0; }
+
+    // Both return true on the leader only, with `md` and `payload` replaced by the merged domain or
+    // field to send on behalf of the node
+    bool domain(message::Metadata& md, message::Payload& payload);
+    bool field(message::Metadata& md, message::Payload& payload);
+
+private:
+    // Concatenates the data of all clients on the leader; `sizes` receives the size of each part
+    std::vector<char> gather(const void* local, size_t size, std::vector<size_t>& sizes) const;
+
+    // For every client of the node, which of its local points belong to its own domain
+    struct Layout {
+        std::vector<size_t> localSizes;
+        std::vector<std::vector<int32_t>> owned;
+    };
+
+    int comm_;  // Fortran handle of the node communicator
+    int rank_;
+    size_t nodeCount_;
+
+    // Names of the domains sent so far, on every client; their layouts, on the leader
+    std::set<std::string> domains_;
+    std::map<std::string, Layout> layouts_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
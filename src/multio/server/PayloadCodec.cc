@@ -0,0 +1,149 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "PayloadCodec.h"
+
+#include <cstring>
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/Resource.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/utils/Compressor.h"
+
+#include "multio/message/BufferPool.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+// Shuffling is done on values of this size, as fields are sent as doubles
+const size_t valueSize = sizeof(double);
+
+const size_t defaultMinimumSize = 4 * 1024;
+
+eckit::Compressor* make_compressor(const std::string& name) {
+    if (name == "none") {
+        return nullptr;
+    }
+    if (not eckit::CompressorFactory::instance().has(name)) {
+        throw eckit::UserError("PayloadCodec: compressor '" + name +
+                                   "' is not available in this build of eckit",
+                               Here());
+    }
+    return eckit::CompressorFactory::instance().build(name);
+}
+
+void reserve(eckit::Buffer& buffer, size_t size) {
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+}
+
+}  // namespace
+
+PayloadCodec::PayloadCodec(const eckit::Configuration& cfg, TransportStatistics& stats) :
+    compressor_{make_compressor(cfg.getString(
+        "compression", eckit::Resource<std::string>(
+                           "multioTransportCompression;$MULTIO_TRANSPORT_COMPRESSION", "none")))},
+    shuffle_{cfg.getBool("shuffle", true)},
+    minimumSize_{eckit::Resource<size_t>(
+        "multioCompressionMinimumSize;$MULTIO_COMPRESSION_MINIMUM_SIZE", defaultMinimumSize)},
+    shuffled_{0},
+    compressed_{0},
+    uncompressed_{0},
+    statistics_{stats} {}
+
+PayloadCodec::~PayloadCodec() = default;
+
+PayloadCodec::Encoded PayloadCodec::encode(const message::Message& msg) {
+    const auto& payload = msg.payload();
+    Encoded raw{Flags::raw, payload.data(), payload.size()};
+
+    if (not enabled() || msg.tag() != message::Message::Tag::Field || payload.size() < minimumSize_) {
+        return raw;
+    }
+
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.compressTiming_};
+
+    unsigned char flags = Flags::compressed;
+    const void* in = payload.data();
+    if (shuffle_ && payload.size() % valueSize == 0) {
+        reserve(shuffled_, payload.size());
+        byte_shuffle(in, shuffled_.data(), payload.size() / valueSize, valueSize);
+        in = shuffled_.data();
+        flags |= Flags::shuffled;
+    }
+
+    auto sz = compressor_->compress(in, payload.size(), compressed_);
+
+    ++statistics_.compressCount_;
+    statistics_.compressInSize_ += payload.size();
+
+    if (sz >= payload.size()) {
+        ++statistics_.incompressibleCount_;
+        statistics_.compressOutSize_ += payload.size();
+        return raw;
+    }
+
+    statistics_.compressOutSize_ += sz;
+    return Encoded{flags, compressed_.data(), sz};
+}
+
+message::Payload PayloadCodec::decode(unsigned char flags, const void* data, size_t size,
+                                      size_t rawSize) {
+    ASSERT(flags & Flags::compressed);
+    if (not enabled()) {
+        throw eckit::SeriousBug(
+            "PayloadCodec: received a compressed payload but no compressor is configured", Here());
+    }
+
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.decompressTiming_};
+
+    reserve(uncompressed_, rawSize);
+    compressor_->uncompress(data, size, uncompressed_, rawSize);
+
+    auto payload = message::BufferPool::instance().allocate(rawSize);
+    if (flags & Flags::shuffled) {
+        ASSERT(rawSize % valueSize == 0);
+        byte_unshuffle(uncompressed_.data(), payload.data(), rawSize / valueSize, valueSize);
+    }
+    else {
+        std::memcpy(payload.data(), uncompressed_.data(), rawSize);
+    }
+
+    ++statistics_.decompressCount_;
+    return payload;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void byte_shuffle(const void* in, void* out, size_t count, size_t width) {
+    auto src = static_cast<const unsigned char*>(in);
+    auto dst = static_cast<unsigned char*>(out);
+    for (size_t ii = 0; ii != count; ++ii) {
+        for (size_t jj = 0; jj != width; ++jj) {
+            dst[jj * count + ii] = src[ii * width + jj];
+        }
+    }
+}
+
+void byte_unshuffle(const void* in, void* out, size_t count, size_t width) {
+    auto src = static_cast<const unsigned char*>(in);
+    auto dst = static_cast<unsigned char*>(out);
+    for (size_t ii = 0; ii != count; ++ii) {
+        for (size_t jj = 0; jj != width; ++jj) {
+            dst[ii * width + jj] = src[jj * count + ii];
+        }
+    }
+}
+
+}  // namespace server
+}  // namespace multio
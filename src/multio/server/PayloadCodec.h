@@ -0,0 +1,88 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_PayloadCodec_H
+#define multio_server_PayloadCodec_H
+
+#include <cstddef>
+#include <memory>
+
+#include "eckit/io/Buffer.h"
+#include "eckit/memory/NonCopyable.h"
+
+#include "multio/message/Message.h"
+#include "multio/server/TransportStatistics.h"
+
+namespace eckit {
+class Compressor;
+class Configuration;
+}  // namespace eckit
+
+namespace multio {
+namespace server {
+
+// Optional lossless compression of field payloads on the wire, for links where bandwidth is scarcer
+// than CPU. Fields of doubles compress poorly byte by byte, so the bytes of all values are first
+// regrouped by significance, which puts the slowly varying sign and exponent bytes next to each
+// other. The result goes through one of eckit's compressors, i.e. any of lz4, snappy, aec or bzip2
+// that eckit was built with.
+//
+// Every message carries flags telling how its payload was encoded, so that small payloads and data
+// that does not compress are sent unchanged. Both ends must be configured with the same compressor.
+
+class PayloadCodec : private eckit::NonCopyable {
+public:
+    enum Flags : unsigned char
+    {
+        raw = 0,
+        compressed = 1,
+        shuffled = 2
+    };
+
+    struct Encoded {
+        unsigned char flags;
+        const void* data;
+        size_t size;
+    };
+
+    PayloadCodec(const eckit::Configuration& cfg, TransportStatistics& stats);
+    ~PayloadCodec();
+
+    bool enabled() const { return compressor_ != nullptr; }
+
+    // Raw payloads are returned as they are; compressed data stays valid until the next call
+    Encoded encode(const message::Message& msg);
+
+    // Restores a payload that was encoded with `flags` other than `raw`
+    message::Payload decode(unsigned char flags, const void* data, size_t size, size_t rawSize);
+
+private:
+    std::unique_ptr<eckit::Compressor> compressor_;
+    const bool shuffle_;
+    const size_t minimumSize_;
+
+    // Scratch space, kept separately for the sending and the receiving side
+    eckit::Buffer shuffled_;
+    eckit::Buffer compressed_;
+    eckit::Buffer uncompressed_;
+
+    TransportStatistics& statistics_;
+};
+
+// Transposes `count` elements of `width` bytes into `width` planes of `count` bytes, and back
+void byte_shuffle(const void* in, void* out, size_t count, size_t width);
+void byte_unshuffle(const void* in, void* out, size_t count, size_t width);
+
+}  // namespace server
+}  // namespace multio
+
+#endif
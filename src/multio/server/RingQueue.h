@@ -0,0 +1,392 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_RingQueue_H
+#define multio_server_RingQueue_H
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+
+namespace multio {
+namespace server {
+
+// Bounded lock-free queues for handing messages between threads. Capacities are rounded up to a
+// power of two, and values are only constructed in a slot while they are queued. Threads that find
+// the queue full or empty spin briefly, then yield, then sleep for increasingly long periods of at
+// most a millisecond, so that an idle consumer costs little CPU without needing a lock on the fast
+// path.
+
+namespace detail {
+
+constexpr size_t cacheLineSize = 64;
+
+inline size_t ring_capacity(size_t requested) {
+    ASSERT(requested != 0);
+    size_t capacity = 1;
+    while (capacity < requested) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Uninitialised storage for a value of type T
+template <typename T>
+class Cell {
+public:
+    void construct(T&& value) { new (&storage_) T(std::move(value)); }
+
+    // Moves the value out and destroys it
+    void take(T& value) {
+        value = std::move(get());
+        destroy();
+    }
+
+    // As above, straight into an output iterator, so that no value is default-constructed
+    template <typename Out>
+    void moveTo(Out& out) {
+        *out++ = std::move(get());
+        destroy();
+    }
+
+    void destroy() { get().~T(); }
+
+private:
+    T& get() { return *reinterpret_cast<T*>(&storage_); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+};
+
+class Backoff {
+public:
+    void operator()() {
+        if (count_ < spinCount) {
+            ++count_;
+            return;
+        }
+        if (count_ < spinCount + yieldCount) {
+            ++count_;
+            std::this_thread::yield();
+            return;
+        }
+        ::usleep(sleep_);
+        // Not std::min, which would need a definition of maxSleep in C++11
+        sleep_ = 2 * sleep_ < maxSleep ? 2 * sleep_ : maxSleep;
+    }
+
+private:
+    static constexpr size_t spinCount = 64;
+    static constexpr size_t yieldCount = 16;
+    static constexpr useconds_t maxSleep = 1000;
+
+    size_t count_ = 0;
+    useconds_t sleep_ = 1;
+};
+
+// Blocking operations and end-of-stream handling shared by the queues below, which only provide
+// the non-blocking ones
+template <typename Queue, typename T>
+class BlockingQueue {
+public:
+    void push(T&& value) {
+        Backoff backoff;
+        while (not queue().tryPush(std::move(value))) {
+            backoff();
+        }
+    }
+
+    template <typename Iter>
+    void push(Iter first, Iter last) {
+        Backoff backoff;
+        while (first != last) {
+            auto pushed = queue().tryPush(first, last);
+            if (pushed == 0) {
+                backoff();
+            }
+            std::advance(first, pushed);
+        }
+    }
+
+    // Blocks until a value is available; returns false once the queue is closed and drained
+    bool pop(T& value) {
+        Backoff backoff;
+        while (not queue().tryPop(value)) {
+            if (closed()) {
+                // Values pushed just before closing must not be lost
+                return queue().tryPop(value);
+            }
+            backoff();
+        }
+        return true;
+    }
+
+    // Blocks until at least one value is available and appends up to `max` values to `batch`;
+    // returns 0 once the queue is closed and drained
+    size_t pop(std::vector<T>& batch, size_t max) {
+        Backoff backoff;
+        size_t popped = 0;
+        while ((popped = queue().tryPop(std::back_inserter(batch), max)) == 0) {
+            if (closed()) {
+                return queue().tryPop(std::back_inserter(batch), max);
+            }
+            backoff();
+        }
+        return popped;
+    }
+
+    // Consumers drain the remaining values, then see end-of-stream
+    void close() { closed_.store(true, std::memory_order_release); }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    Queue& queue() { return static_cast<Queue&>(*this); }
+
+    std::atomic<bool> closed_{false};
+};
+
+}  // namespace detail
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Single producer, single consumer
+template <typename T>
+class SpscQueue : public detail::BlockingQueue<SpscQueue<T>, T> {
+public:
+    explicit SpscQueue(size_t capacity) :
+        capacity_{detail::ring_capacity(capacity)},
+        slots_{new detail::Cell<T>[capacity_]},
+        mask_{capacity_ - 1} {}
+
+    ~SpscQueue() {
+        for (auto head = head_.load(); head != tail_.load(); ++head) {
+            slots_[head & mask_].destroy();
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool tryPush(T&& value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == capacity_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == capacity_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_].construct(std::move(value));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves as many values as fit and returns how many that was
+    template <typename Iter>
+    size_t tryPush(Iter first, Iter last) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        headCache_ = head_.load(std::memory_order_acquire);
+
+        auto count = std::min<size_t>(std::distance(first, last), capacity_ - (tail - headCache_));
+        for (auto ii = 0ul; ii != count; ++ii, ++first) {
+            slots_[(tail + ii) & mask_].construct(std::move(*first));
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool tryPop(T& value) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) {
+                return false;
+            }
+        }
+        slots_[head & mask_].take(value);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Out>
+    size_t tryPop(Out out, size_t max) {
+        auto head = head_.load(std::memory_order_relaxed);
+        tailCache_ = tail_.load(std::memory_order_acquire);
+
+        auto count = std::min<size_t>(max, tailCache_ - head);
+        for (auto ii = 0ul; ii != count; ++ii) {
+            slots_[(head + ii) & mask_].moveTo(out);
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<detail::Cell<T>[]> slots_;
+    const size_t mask_;
+
+    // Each index is written by one side only; the caches spare reading the other side's line
+    alignas(detail::cacheLineSize) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+
+    alignas(detail::cacheLineSize) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Multiple producers, single consumer. Every slot carries a sequence number telling whether it is
+// free or full for a given lap around the ring, so that producers only contend on claiming
+// positions.
+
+template <typename T>
+class MpscQueue : public detail::BlockingQueue<MpscQueue<T>, T> {
+public:
+    explicit MpscQueue(size_t capacity) :
+        slots_(detail::ring_capacity(capacity)), mask_{slots_.size() - 1} {
+        for (auto ii = 0ul; ii != slots_.size(); ++ii) {
+            slots_[ii].sequence.store(ii, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpscQueue() {
+        while (lap(slots_[head_ & mask_], head_ + 1) == 0) {
+            slots_[head_ & mask_].value.destroy();
+            ++head_;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    bool tryPush(T&& value) {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots_[pos & mask_];
+            auto diff = lap(slot, pos);
+            if (diff < 0) {
+                return false;
+            }
+            if (diff == 0 && tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.value.construct(std::move(value));
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+            if (diff > 0) {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Claims a contiguous range of slots in one go and returns how many values were moved. Slots
+    // are freed in order, so the range is free if its last slot is.
+    template <typename Iter>
+    size_t tryPush(Iter first, Iter last) {
+        auto requested = std::min<size_t>(std::distance(first, last), slots_.size());
+        auto pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            auto diff = lap(slots_[pos & mask_], pos);
+            if (diff < 0 || requested == 0) {
+                return 0;
+            }
+            if (diff > 0) {
+                pos = tail_.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            // Another producer may have claimed the first slot meanwhile, in which case start over
+            auto count = requested;
+            while (count > 0 && lap(slots_[(pos + count - 1) & mask_], pos + count - 1) != 0) {
+                --count;
+            }
+            if (count == 0) {
+                pos = tail_.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (tail_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                for (auto ii = 0ul; ii != count; ++ii, ++first) {
+                    auto& slot = slots_[(pos + ii) & mask_];
+                    slot.value.construct(std::move(*first));
+                    slot.sequence.store(pos + ii + 1, std::memory_order_release);
+                }
+                return count;
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        auto& slot = slots_[head_ & mask_];
+        if (lap(slot, head_ + 1) != 0) {
+            return false;
+        }
+        slot.value.take(value);
+        slot.sequence.store(head_ + slots_.size(), std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    template <typename Out>
+    size_t tryPop(Out out, size_t max) {
+        size_t count = 0;
+        while (count != max) {
+            auto& slot = slots_[head_ & mask_];
+            if (lap(slot, head_ + 1) != 0) {
+                break;
+            }
+            slot.value.moveTo(out);
+            slot.sequence.store(head_ + slots_.size(), std::memory_order_release);
+            ++head_;
+            ++count;
+        }
+        return count;
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        detail::Cell<T> value;
+    };
+
+    static std::intptr_t lap(const Slot& slot, size_t expected) {
+        return static_cast<std::intptr_t>(slot.sequence.load(std::memory_order_acquire)) -
+               static_cast<std::intptr_t>(expected);
+    }
+
+    std::vector<Slot> slots_;
+    const size_t mask_;
+
+    alignas(detail::cacheLineSize) std::atomic<size_t> tail_{0};
+
+    // Only touched by the consumer
+    alignas(detail::cacheLineSize) size_t head_ = 0;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -0,0 +1,366 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "RmaTransport.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "eckit/config/Resource.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Log.h"
+#include "eckit/maths/Functions.h"
+
+#include "multio/LibMultio.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+const size_t defaultRingSize = 16 * 1024 * 1024;
+const size_t defaultBatchSize = 1024 * 1024;
+
+// Each client's ring positions sit on a cache line of their own
+const MPI_Aint controlSize = 64;
+
+const useconds_t spacePollInterval = 50;  // microseconds
+
+void mpi_call(int code, const char* call) {
+    if (code != MPI_SUCCESS) {
+        throw eckit::SeriousBug(std::string{"RmaTransport: "} + call + " failed with error " +
+                                    std::to_string(code),
+                                Here());
+    }
+}
+
+}  // namespace
+
+RmaTransport::Outbox::Outbox(size_t size) : buffer{size}, stream{new MpiOutputStream{buffer}} {}
+
+RmaTransport::RmaTransport(const eckit::Configuration& config) :
+    MpiTransport{config},
+    clientCount_{config.getUnsigned("clientCount")},
+    ringSize_{config.getUnsigned(
+        "ringSize",
+        eckit::Resource<size_t>("multioMpiRmaRingSize;$MULTIO_MPI_RMA_RING_SIZE", defaultRingSize))},
+    batchSize_{config.getUnsigned(
+        "batchSize",
+        eckit::Resource<size_t>("multioMpiRmaBatchSize;$MULTIO_MPI_RMA_BATCH_SIZE", defaultBatchSize))},
+    rank_{static_cast<int>(comm().rank())},
+    comm_{MPI_Comm_f2c(comm().communicator())} {
+    if (2 * batchSize_ > ringSize_) {
+        throw eckit::UserError("RmaTransport: batch size must be at most half the ring size", Here());
+    }
+
+    auto isServer = static_cast<size_t>(rank_) >= clientCount_;
+    MPI_Aint size = isServer ? clientCount_ * (controlSize + ringSize_) : 0;
+
+    mpi_call(MPI_Win_allocate(size, 1, MPI_INFO_NULL, comm_, &base_, &window_), "MPI_Win_allocate");
+    if (isServer) {
+        std::memset(base_, 0, clientCount_ * controlSize);
+        positions_.resize(clientCount_, 0);
+        published_.resize(clientCount_, 0);
+        released_ = std::make_shared<std::vector<std::atomic<uint64_t>>>(clientCount_);
+        for (auto& released : *released_) {
+            released.store(0);
+        }
+    }
+
+    // Passive target throughout: every rank may access any window at any time
+    mpi_call(MPI_Win_lock_all(MPI_MODE_NOCHECK, window_), "MPI_Win_lock_all");
+    mpi_call(MPI_Barrier(comm_), "MPI_Barrier");
+
+    eckit::Log::debug<LibMultio>() << *this << std::endl;
+}
+
+RmaTransport::~RmaTransport() {
+    MPI_Win_unlock_all(window_);
+    MPI_Win_free(&window_);
+}
+
+RmaTransport::Outbox& RmaTransport::outbox(int server) {
+    auto it = outboxes_.find(server);
+    if (it == std::end(outboxes_)) {
+        it = outboxes_.emplace(server, std::unique_ptr<Outbox>{new Outbox{batchSize_}}).first;
+        tails_[server] = 0;
+        heads_[server] = 0;
+    }
+    return *it->second;
+}
+
+void RmaTransport::send(const Message& msg) {
+    progressSteps(false);
+
+    auto server = static_cast<int>(msg.destination().id());
+    bufferedSend(msg);
+
+    auto& box = outbox(server);
+    if (box.stream->messageCount() != 0) {
+        put(server, box);
+    }
+}
+
+void RmaTransport::bufferedSend(const Message& msg) {
+    progressSteps(false);
+
+    auto server = static_cast<int>(msg.destination().id());
+    auto& box = outbox(server);
+
+    if (box.stream->messageCount() != 0 &&
+        not box.stream->canFitMessage(eckit::round(msg.size(), 8))) {
+        put(server, box);
+    }
+
+    encodeMessage(*box.stream, msg);
+    box.stream->messageWritten();
+
+    // Control messages go out straight away, as with the step flush policy
+    if (msg.tag() != Message::Tag::Field) {
+        put(server, box);
+    }
+}
+
+void RmaTransport::flushTo(const Peer& server) {
+    auto id = static_cast<int>(server.id());
+    auto& box = outbox(id);
+    if (box.stream->messageCount() != 0) {
+        put(id, box);
+    }
+}
+
+void RmaTransport::put(int server, Outbox& box) {
+    auto sz = box.stream->finalise();
+    const auto* data = static_cast<const char*>(box.buffer.content.data());
+
+    if (sz <= batchSize_) {
+        put(server, data, sz);
+    }
+    else {
+        // A message larger than a batch grew the buffer. It goes through the ring in parts, which
+        // the server puts back together, so that it need not fit into the ring as a whole.
+        std::vector<char> part;
+        FramePart where{static_cast<uint64_t>(rank_), sz, 0};
+        while (where.offset != sz) {
+            where.offset += MpiOutputStream::writePart(data, where, batchSize_, part);
+            put(server, part.data(), part.size());
+            ++statistics_.framePartCount_;
+        }
+        box.buffer.content.resize(batchSize_);
+    }
+
+    box.stream.reset(new MpiOutputStream{box.buffer});
+}
+
+void RmaTransport::put(int server, const char* data, size_t sz) {
+    ASSERT(sz <= batchSize_);
+
+    auto& tail = tails_[server];
+    auto& head = heads_[server];
+
+    // The cached position of the server is behind, so it only needs refreshing when space is short
+    if (ringSize_ - (tail - head) < sz) {
+        head = fetch(server, headDisp(rank_));
+        if (ringSize_ - (tail - head) < sz) {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.waitTiming_};
+            ++statistics_.bufferWaitCount_;
+            while (ringSize_ - (tail - head) < sz) {
+                ::usleep(spacePollInterval);
+                head = fetch(server, headDisp(rank_));
+            }
+        }
+    }
+
+    {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.isendTiming_};
+
+        // The buffer may wrap around the end of the ring
+        auto offset = tail % ringSize_;
+        auto first = std::min(sz, ringSize_ - offset);
+
+        mpi_call(MPI_Put(data, static_cast<int>(first), MPI_BYTE, server,
+                         dataDisp(rank_) + static_cast<MPI_Aint>(offset), static_cast<int>(first),
+                         MPI_BYTE, window_),
+                 "MPI_Put");
+        if (first != sz) {
+            mpi_call(MPI_Put(data + first, static_cast<int>(sz - first), MPI_BYTE, server,
+                             dataDisp(rank_), static_cast<int>(sz - first), MPI_BYTE, window_),
+                     "MPI_Put");
+        }
+
+        // The data must have arrived before the server can see the new end of the ring
+        mpi_call(MPI_Win_flush(server, window_), "MPI_Win_flush");
+        tail += sz;
+        store(server, tailDisp(rank_), tail);
+    }
+
+    ++statistics_.isendCount_;
+    statistics_.isendSize_ += sz;
+}
+
+void RmaTransport::listen() {
+    bool received = false;
+    for (auto ii = 0u; ii != clientCount_; ++ii) {
+        received = poll((next_ + ii) % clientCount_) || received;
+    }
+    next_ = (next_ + 1) % clientCount_;
+
+    if (received) {
+        listenBackoff_ = 0;
+    }
+    else {
+        backOff();
+    }
+}
+
+bool RmaTransport::poll(size_t client) {
+    publish(client);
+
+    uint64_t tail = 0;
+    {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.probeTiming_};
+        tail = fetch(rank_, tailDisp(client));
+    }
+
+    auto& head = positions_[client];
+    if (tail == head) {
+        return false;
+    }
+
+    // Make the data put by the client visible to local loads
+    mpi_call(MPI_Win_sync(window_), "MPI_Win_sync");
+
+    auto* ring = base_ + dataDisp(client);
+    auto copy = [this, ring](void* to, uint64_t from, size_t sz) {
+        auto offset = from % ringSize_;
+        auto first = std::min(sz, ringSize_ - offset);
+        std::memcpy(to, ring + offset, first);
+        std::memcpy(static_cast<char*>(to) + first, ring, sz - first);
+    };
+
+    uint64_t header = 0;
+    copy(&header, head, sizeof(header));
+    auto sz = MpiInputStream::frameSize(header);
+    ASSERT(sz <= tail - head);
+
+    // Streams of a client are released in the order they were queued, as they lend no payloads
+    auto offset = head % ringSize_;
+    auto end = head + sz;
+    auto released = released_;
+
+    if (MpiInputStream::isPart(header)) {
+        // Parts are copied out and their space handed back straight away, as the client may have
+        // more of the frame to put than the ring holds. That keeps the order only once all the
+        // streams queued before have been released.
+        if ((*released)[client].load(std::memory_order_acquire) != head) {
+            return false;
+        }
+
+        auto& buf = pool_.findAvailableBuffer(sz);
+        {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.receiveTiming_};
+            copy(buf.content.data(), head, sz);
+        }
+        (*released)[client].store(end, std::memory_order_release);
+        head = end;
+
+        ++statistics_.receiveCount_;
+        statistics_.receiveSize_ += sz;
+
+        received(buf, sz);
+        return true;
+    }
+
+    ++statistics_.receiveCount_;
+    statistics_.receiveSize_ += sz;
+
+    if (offset + sz <= ringSize_) {
+        // Decoded in place; the client can reuse the space once the stream is gone
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.pushToQueueTiming_};
+        streamQueue_.emplace(ring + offset, sz, [released, client, end]() {
+            (*released)[client].store(end, std::memory_order_release);
+        });
+    }
+    else {
+        // Only buffers wrapping around the end of the ring are copied out
+        auto& buf = pool_.findAvailableBuffer(sz);
+        {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.receiveTiming_};
+            copy(buf.content.data(), head, sz);
+        }
+
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.pushToQueueTiming_};
+        auto* data = static_cast<char*>(buf.content.data());
+        streamQueue_.emplace(data, sz, [this, &buf, released, client, end]() {
+            pool_.release(buf);
+            (*released)[client].store(end, std::memory_order_release);
+        });
+    }
+
+    head = end;
+    return true;
+}
+
+void RmaTransport::publish(size_t client) {
+    auto released = (*released_)[client].load(std::memory_order_acquire);
+    if (released != published_[client]) {
+        store(rank_, headDisp(client), released);
+        published_[client] = released;
+    }
+}
+
+void RmaTransport::consumed(const Message& msg) {
+    // Clients are held back by the capacity of their rings, so only the backlog is tracked
+    if (flowControl_.enabled()) {
+        flowControl_.consumed(msg, false);
+    }
+}
+
+uint64_t RmaTransport::fetch(int rank, MPI_Aint disp) {
+    uint64_t value = 0;
+    uint64_t unused = 0;
+    mpi_call(MPI_Fetch_and_op(&unused, &value, MPI_UINT64_T, rank, disp, MPI_NO_OP, window_),
+             "MPI_Fetch_and_op");
+    mpi_call(MPI_Win_flush(rank, window_), "MPI_Win_flush");
+    return value;
+}
+
+void RmaTransport::store(int rank, MPI_Aint disp, uint64_t value) {
+    mpi_call(MPI_Accumulate(&value, 1, MPI_UINT64_T, rank, disp, 1, MPI_UINT64_T, MPI_REPLACE,
+                            window_),
+             "MPI_Accumulate");
+    mpi_call(MPI_Win_flush(rank, window_), "MPI_Win_flush");
+}
+
+MPI_Aint RmaTransport::headDisp(size_t client) const {
+    return static_cast<MPI_Aint>(client) * controlSize;
+}
+
+MPI_Aint RmaTransport::tailDisp(size_t client) const {
+    return headDisp(client) + static_cast<MPI_Aint>(sizeof(uint64_t));
+}
+
+MPI_Aint RmaTransport::dataDisp(size_t client) const {
+    return static_cast<MPI_Aint>(clientCount_) * controlSize +
+           static_cast<MPI_Aint>(client) * static_cast<MPI_Aint>(ringSize_);
+}
+
+void RmaTransport::print(std::ostream& os) const {
+    os << "RmaTransport(" << local_ << ", rings=" << clientCount_ << " x " << ringSize_
+       << " bytes, batch=" << batchSize_ << " bytes)";
+}
+
+static TransportBuilder<RmaTransport> RmaTransportBuilder("mpi-rma");
+
+}  // namespace server
+}  // namespace multio
@@ -0,0 +1,112 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_RmaTransport_H
+#define multio_server_RmaTransport_H
+
+#include <mpi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "multio/server/MpiTransport.h"
+
+namespace multio {
+namespace server {
+
+// MPI transport using one-sided communication instead of send/receive. Every server exposes an MPI
+// window holding a ring buffer per client. Clients batch messages into a local buffer, laid out
+// like an MPI buffer, put it into their ring on the server and then publish the new end of the ring
+// with an atomic update. Servers poll the ends of their rings and decode new buffers where they
+// are, copying out only the payloads and the rare buffer that wraps around the end of the ring.
+// The server hands the space of a buffer back once its stream has been consumed. Clients read the
+// server's position in the ring only when they run out of space. A message too large for a batch
+// is put in parts of a batch each, which the server copies out and puts back together.
+//
+// There is no matching, no unexpected-message queue and no receive on the server. Creating and
+// freeing the window is collective: all ranks of the group must construct and destroy the transport.
+
+class RmaTransport final : public MpiTransport {
+public:
+    RmaTransport(const eckit::Configuration& config);
+    ~RmaTransport();
+
+private:
+    struct Outbox {
+        explicit Outbox(size_t size);
+
+        MpiBuffer buffer;
+        std::unique_ptr<MpiOutputStream> stream;
+    };
+
+    void send(const Message& msg) override;
+
+    void bufferedSend(const Message& msg) override;
+
+    void listen() override;
+
+    void consumed(const Message& msg) override;
+
+    void flushTo(const Peer& server) override;
+
+    void print(std::ostream& os) const override;
+
+    Outbox& outbox(int server);
+
+    // Client side: puts the staged buffer into the server's ring, in parts if it has outgrown a
+    // batch, and resets the outbox
+    void put(int server, Outbox& box);
+    void put(int server, const char* data, size_t sz);
+
+    // Server side: queues a stream over the next buffer, if any, in the client's ring
+    bool poll(size_t client);
+
+    // Server side: tells the client how far the streams from its ring have been consumed
+    void publish(size_t client);
+
+    // Atomic access to the ring positions
+    uint64_t fetch(int rank, MPI_Aint disp);
+    void store(int rank, MPI_Aint disp, uint64_t value);
+
+    MPI_Aint headDisp(size_t client) const;
+    MPI_Aint tailDisp(size_t client) const;
+    MPI_Aint dataDisp(size_t client) const;
+
+    const size_t clientCount_;
+    const size_t ringSize_;
+    const size_t batchSize_;
+    const int rank_;
+
+    MPI_Comm comm_;
+    MPI_Win window_;
+    char* base_ = nullptr;
+
+    // Client side: per server
+    std::map<int, std::unique_ptr<Outbox>> outboxes_;
+    std::map<int, uint64_t> tails_;
+    std::map<int, uint64_t> heads_;
+
+    // Server side: per client, how far the ring has been queued, consumed and told the client.
+    // Shared with the streams, which may outlive the transport.
+    std::vector<uint64_t> positions_;
+    std::shared_ptr<std::vector<std::atomic<uint64_t>>> released_;
+    std::vector<uint64_t> published_;
+    size_t next_ = 0;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
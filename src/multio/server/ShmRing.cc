@@ -0,0 +1,242 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "ShmRing.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/maths/Functions.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+const long spaceTimeout = 10;  // milliseconds
+const long dataTimeout = 10;   // milliseconds
+
+// The words live in shared memory, so these are the process-shared futex operations
+void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, long timeoutMillis) {
+    ::timespec timeout{timeoutMillis / 1000, (timeoutMillis % 1000) * 1000000};
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout,
+              nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t>& word) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr,
+              0);
+}
+
+void* map_segment(int fd, size_t size) {
+    auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw eckit::FailedSystemCall("mmap", Here());
+    }
+    return address;
+}
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SharedSegment SharedSegment::create(const std::string& name, size_t size) {
+    auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw eckit::FailedSystemCall("shm_open(" + name + ")", Here());
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw eckit::FailedSystemCall("ftruncate(" + name + ")", Here());
+    }
+    return SharedSegment{name, map_segment(fd, size), size};
+}
+
+SharedSegment SharedSegment::open(const std::string& name) {
+    auto fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        throw eckit::FailedSystemCall("shm_open(" + name + ")", Here());
+    }
+
+    struct ::stat info;
+    if (::fstat(fd, &info) < 0) {
+        ::close(fd);
+        throw eckit::FailedSystemCall("fstat(" + name + ")", Here());
+    }
+
+    auto size = static_cast<size_t>(info.st_size);
+    return SharedSegment{name, map_segment(fd, size), size};
+}
+
+SharedSegment::SharedSegment(const std::string& name, void* address, size_t size) :
+    name_{name}, address_{address}, size_{size} {}
+
+SharedSegment::SharedSegment(SharedSegment&& rhs) noexcept :
+    name_{std::move(rhs.name_)}, address_{rhs.address_}, size_{rhs.size_} {
+    rhs.address_ = nullptr;
+}
+
+SharedSegment::~SharedSegment() {
+    if (address_) {
+        ::munmap(address_, size_);
+    }
+}
+
+void SharedSegment::unlink() {
+    ::shm_unlink(name_.c_str());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Doorbell::ring() {
+    sequence.fetch_add(1, std::memory_order_release);
+    if (sleeping.load() != 0) {
+        futex_wake(sequence);
+    }
+}
+
+void Doorbell::wait(uint32_t seen, long timeoutMillis) {
+    // Returns straight away if the sequence has moved on since `seen` was read
+    sleeping.fetch_add(1);
+    futex_wait(sequence, seen, timeoutMillis);
+    sleeping.fetch_sub(1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+struct ShmRing::Control {
+    uint64_t capacity;
+
+    alignas(64) std::atomic<uint64_t> head;  // Bytes published by the producer
+    alignas(64) std::atomic<uint64_t> tail;  // Bytes consumed
+
+    alignas(64) std::atomic<uint32_t> consumed;  // Bumped whenever the consumer frees space
+    std::atomic<uint32_t> producerWaiting;
+};
+
+size_t ShmRing::dataOffset() {
+    return eckit::round(sizeof(Control), 64);
+}
+
+size_t ShmRing::segmentSize(size_t capacity) {
+    return dataOffset() + capacity;
+}
+
+ShmRing::ShmRing(SharedSegment&& segment, size_t capacity, Doorbell& doorbell) :
+    segment_{std::move(segment)},
+    control_{new (segment_.address()) Control{}},
+    data_{static_cast<char*>(segment_.address()) + dataOffset()},
+    doorbell_{doorbell} {
+    ASSERT(segment_.size() >= segmentSize(capacity));
+    control_->capacity = capacity;
+}
+
+ShmRing::ShmRing(SharedSegment&& segment, Doorbell& doorbell) :
+    segment_{std::move(segment)},
+    control_{static_cast<Control*>(segment_.address())},
+    data_{static_cast<char*>(segment_.address()) + dataOffset()},
+    doorbell_{doorbell} {
+    ASSERT(segment_.size() >= segmentSize(control_->capacity));
+}
+
+void ShmRing::write(const void* data, size_t size) {
+    const auto capacity = control_->capacity;
+    auto bytes = static_cast<const char*>(data);
+
+    while (size != 0) {
+        auto head = control_->head.load(std::memory_order_relaxed);
+        auto space = capacity - (head - control_->tail.load(std::memory_order_acquire));
+
+        if (space == 0) {
+            auto seen = control_->consumed.load(std::memory_order_acquire);
+            control_->producerWaiting.store(1);
+            if (head - control_->tail.load(std::memory_order_acquire) == capacity) {
+                futex_wait(control_->consumed, seen, spaceTimeout);
+            }
+            control_->producerWaiting.store(0);
+            continue;
+        }
+
+        auto count = std::min(size, static_cast<size_t>(space));
+        auto offset = static_cast<size_t>(head % capacity);
+        auto first = std::min(count, static_cast<size_t>(capacity) - offset);
+        std::memcpy(data_ + offset, bytes, first);
+        std::memcpy(data_, bytes + first, count - first);
+
+        control_->head.store(head + count, std::memory_order_release);
+        doorbell_.ring();
+
+        bytes += count;
+        size -= count;
+    }
+}
+
+size_t ShmRing::readable() const {
+    return static_cast<size_t>(control_->head.load(std::memory_order_acquire) -
+                               control_->tail.load(std::memory_order_relaxed));
+}
+
+void ShmRing::peek(void* data, size_t size) const {
+    ASSERT(readable() >= size);
+
+    const auto capacity = static_cast<size_t>(control_->capacity);
+    auto offset = static_cast<size_t>(control_->tail.load(std::memory_order_relaxed) % capacity);
+    auto first = std::min(size, capacity - offset);
+    std::memcpy(data, data_ + offset, first);
+    std::memcpy(static_cast<char*>(data) + first, data_, size - first);
+}
+
+void ShmRing::read(void* data, size_t size) {
+    auto bytes = static_cast<char*>(data);
+
+    while (size != 0) {
+        auto available = readable();
+        if (available == 0) {
+            // The producer is part-way through this record
+            auto seen = doorbell_.sequence.load(std::memory_order_acquire);
+            if (readable() == 0) {
+                doorbell_.wait(seen, dataTimeout);
+            }
+            continue;
+        }
+
+        auto count = std::min(size, available);
+        peek(bytes, count);
+        control_->tail.fetch_add(count, std::memory_order_release);
+
+        control_->consumed.fetch_add(1, std::memory_order_release);
+        if (control_->producerWaiting.load() != 0) {
+            futex_wake(control_->consumed);
+        }
+
+        bytes += count;
+        size -= count;
+    }
+}
+
+void ShmRing::unlink() {
+    segment_.unlink();
+}
+
+}  // namespace server
+}  // namespace multio
@@ -0,0 +1,101 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_ShmRing_H
+#define multio_server_ShmRing_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "eckit/memory/NonCopyable.h"
+
+namespace multio {
+namespace server {
+
+// A POSIX shared-memory segment, mapped for the lifetime of the object. The creator is responsible
+// for unlinking the name, which can be done as soon as every process has mapped it.
+
+class SharedSegment : private eckit::NonCopyable {
+public:
+    static SharedSegment create(const std::string& name, size_t size);
+    static SharedSegment open(const std::string& name);
+
+    SharedSegment(SharedSegment&& rhs) noexcept;
+    ~SharedSegment();
+
+    void unlink();
+
+    void* address() const { return address_; }
+    size_t size() const { return size_; }
+
+private:
+    SharedSegment(const std::string& name, void* address, size_t size);
+
+    std::string name_;
+    void* address_;
+    size_t size_;
+};
+
+// Counter that a consumer can sleep on until a producer in another process bumps it
+struct Doorbell {
+    alignas(64) std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> sleeping;
+
+    void ring();
+
+    // Returns when the sequence has moved on from `seen` or after `timeoutMillis`
+    void wait(uint32_t seen, long timeoutMillis);
+};
+
+// Single-producer, single-consumer byte ring in shared memory. Records may be larger than the
+// ring: the producer publishes data as space becomes available and the consumer waits for the
+// rest of a record it has started reading. The producer rings the consumer's doorbell whenever it
+// publishes data.
+
+class ShmRing : private eckit::NonCopyable {
+public:
+    static size_t segmentSize(size_t capacity);
+
+    // Lays out an empty ring in a newly created segment
+    ShmRing(SharedSegment&& segment, size_t capacity, Doorbell& doorbell);
+
+    // Maps an existing ring
+    ShmRing(SharedSegment&& segment, Doorbell& doorbell);
+
+    void write(const void* data, size_t size);
+
+    size_t readable() const;
+
+    // Copies without consuming; requires `size` readable bytes
+    void peek(void* data, size_t size) const;
+
+    void read(void* data, size_t size);
+
+    void unlink();
+
+private:
+    struct Control;
+
+    static size_t dataOffset();
+
+    SharedSegment segment_;
+    Control* control_;
+    char* data_;
+    Doorbell& doorbell_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "ShmTransport.h"
+
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <new>
+
+#include "eckit/config/Resource.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Log.h"
+
+#include "multio/LibMultio.h"
+
+namespace multio {
+namespace server {
+
+namespace {
+
+// Records larger than a ring are streamed through it, so a few MiB keep the writers going without
+// tying up much memory; there is a ring for every pair of a client and a server on a node
+const size_t defaultRingSize = 4 * 1024 * 1024;
+const long doorbellTimeout = 10;  // milliseconds
+
+size_t host_hash() {
+    char host[256] = {};
+    if (::gethostname(host, sizeof(host) - 1) < 0) {
+        throw eckit::FailedSystemCall("gethostname", Here());
+    }
+    return std::hash<std::string>{}(host);
+}
+
+// Space left in the file system backing POSIX shared memory
+size_t available_shared_memory() {
+    struct ::statvfs stats;
+    if (::statvfs("/dev/shm", &stats) < 0) {
+        throw eckit::FailedSystemCall("statvfs /dev/shm", Here());
+    }
+    return static_cast<size_t>(stats.f_bavail) * static_cast<size_t>(stats.f_frsize);
+}
+
+}  // namespace
+
+ShmTransport::ShmTransport(const eckit::Configuration& config) :
+    MpiTransport{config}, scratch_{4096} {
+    connect(config);
+}
+
+ShmTransport::~ShmTransport() = default;
+
+void ShmTransport::connect(const eckit::Configuration& config) {
+    const auto& comm = this->comm();
+
+    auto ringSize = config.getUnsigned(
+        "ringSize", eckit::Resource<size_t>("multioShmRingSize;$MULTIO_SHM_RING_SIZE", defaultRingSize));
+    auto clientCount = config.getUnsigned("clientCount");
+    auto serverCount = config.getUnsigned("serverCount");
+    auto rank = comm.rank();
+
+    std::vector<size_t> hosts(comm.size());
+    comm.allGather(host_hash(), std::begin(hosts), std::end(hosts));
+
+    // Segment names must be unique to this run
+    long tag = static_cast<long>(::getpid());
+    comm.broadcast(tag, 0);
+    auto prefix = "/multio-" + std::to_string(tag) + "-";
+
+    auto ringName = [&prefix](size_t client, size_t server) {
+        return prefix + std::to_string(client) + "-" + std::to_string(server);
+    };
+
+    // Before any ring is created, the servers of a node check that all of their rings fit
+    if (rank >= clientCount) {
+        auto onNode = [&hosts, rank](size_t first, size_t last) {
+            return static_cast<size_t>(
+                std::count(std::begin(hosts) + first, std::begin(hosts) + last, hosts[rank]));
+        };
+        auto required = onNode(0, clientCount) * onNode(clientCount, clientCount + serverCount) *
+                        ShmRing::segmentSize(ringSize);
+        auto available = available_shared_memory();
+        if (required > available) {
+            throw eckit::UserError("ShmTransport: rings of " + std::to_string(ringSize) +
+                                       " bytes need " + std::to_string(required) +
+                                       " bytes of shared memory on this node but only " +
+                                       std::to_string(available) +
+                                       " are available; lower multioShmRingSize",
+                                   Here());
+        }
+    }
+
+    comm.barrier();
+
+    if (rank >= clientCount) {
+        doorbells_.push_back(SharedSegment::create(prefix + std::to_string(rank), sizeof(Doorbell)));
+        doorbell_ = new (doorbells_.back().address()) Doorbell{};
+
+        for (auto client = 0ul; client < clientCount; ++client) {
+            if (hosts[client] != hosts[rank]) {
+                ++remoteClients_;
+                continue;
+            }
+            localClients_.insert(client);
+            auto segment = SharedSegment::create(ringName(client, rank), ShmRing::segmentSize(ringSize));
+            inbound_.emplace_back(new ShmRing{std::move(segment), ringSize, *doorbell_});
+        }
+    }
+
+    comm.barrier();
+
+    if (rank < clientCount) {
+        for (auto server = clientCount; server < clientCount + serverCount; ++server) {
+            if (hosts[server] != hosts[rank]) {
+                continue;
+            }
+            doorbells_.push_back(SharedSegment::open(prefix + std::to_string(server)));
+            auto& doorbell = *static_cast<Doorbell*>(doorbells_.back().address());
+
+            outbound_.emplace(MpiPeer{local_.group(), server},
+                              std::unique_ptr<ShmRing>{new ShmRing{
+                                  SharedSegment::open(ringName(rank, server)), doorbell}});
+        }
+    }
+
+    comm.barrier();
+
+    // Everybody has mapped the segments by now, so the names are no longer needed
+    if (doorbell_) {
+        doorbells_.front().unlink();
+        for (auto& ring : inbound_) {
+            ring->unlink();
+        }
+    }
+
+    eckit::Log::debug<LibMultio>() << *this << std::endl;
+}
+
+void ShmTransport::send(const Message& msg) {
+    auto it = outbound_.find(msg.destination());
+    if (it == std::end(outbound_)) {
+        MpiTransport::send(msg);
+        return;
+    }
+    write(*it->second, msg);
+}
+
+void ShmTransport::bufferedSend(const Message& msg) {
+    auto it = outbound_.find(msg.destination());
+    if (it == std::end(outbound_)) {
+        MpiTransport::bufferedSend(msg);
+        return;
+    }
+    write(*it->second, msg);
+}
+
+void ShmTransport::write(ShmRing& ring, const Message& msg) {
+    progressSteps(false);
+    countSent(msg);
+
+    // Only the header is serialised here; the payload goes straight from the caller's memory into
+    // the shared segment. Payloads are never compressed between processes on the same node.
+    size_t sz = 0;
+    {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.encodeTiming_};
+        MpiOutputStream strm{scratch_};
+        msg.header().encode(strm);
+        strm << static_cast<unsigned char>(PayloadCodec::raw);
+        strm << static_cast<unsigned long>(msg.size());
+        strm.writePayload(message::Payload{});
+        sz = strm.finalise(msg.size());
+    }
+
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.sendTiming_};
+    ring.write(scratch_.content.data(), sz);
+    if (msg.size() != 0) {
+        ring.write(msg.payload().data(), msg.size());
+    }
+
+    ++statistics_.shmSendCount_;
+    statistics_.shmSendSize_ += sz + msg.size();
+}
+
+void ShmTransport::listen() {
+    auto received = pollRings();
+
+    if (remoteClients_ != 0) {
+        MpiTransport::listen();
+        return;
+    }
+
+    if (not received && doorbell_) {
+        auto seen = doorbell_->sequence.load();
+        if (not anyReadable()) {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.idleTiming_};
+            doorbell_->wait(seen, doorbellTimeout);
+        }
+    }
+}
+
+void ShmTransport::consumed(const Message& msg) {
+    // Clients writing to a ring are held back by its capacity instead of credit, but their messages
+    // still count towards the load reported to the others
+    if (flowControl_.enabled()) {
+        flowControl_.consumed(msg, localClients_.find(msg.source().id()) == std::end(localClients_));
+    }
+}
+
+bool ShmTransport::pollRings() {
+    bool received = false;
+    for (auto ii = 0u; ii < inbound_.size(); ++ii) {
+        auto& ring = *inbound_[(next_ + ii) % inbound_.size()];
+        if (ring.readable() < sizeof(uint64_t)) {
+            continue;
+        }
+
+        // Every record is the image of an MPI buffer, which starts with its length
+        uint64_t sz;
+        ring.peek(&sz, sizeof(sz));
+
+        auto& buf = pool_.findAvailableBuffer(sz);
+        {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.receiveTiming_};
+            ring.read(buf.content.data(), sz);
+        }
+
+        ++statistics_.shmReceiveCount_;
+        statistics_.shmReceiveSize_ += sz;
+
+        streamQueue_.emplace(buf, sz, [this](MpiBuffer& released) { pool_.release(released); });
+        received = true;
+    }
+
+    // Start from a different ring next time, so that none of them is favoured
+    if (not inbound_.empty()) {
+        next_ = (next_ + 1) % inbound_.size();
+    }
+
+    return received;
+}
+
+bool ShmTransport::anyReadable() const {
+    for (const auto& ring : inbound_) {
+        if (ring->readable() != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmTransport::print(std::ostream& os) const {
+    os << "ShmTransport(" << local_ << ", rings=" << (doorbell_ ? inbound_.size() : outbound_.size())
+       << ", remoteClients=" << remoteClients_ << ")";
+}
+
+static TransportBuilder<ShmTransport> ShmTransportBuilder("shm");
+
+}  // namespace server
+}  // namespace multio
@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_ShmTransport_H
+#define multio_server_ShmTransport_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "multio/server/MpiTransport.h"
+#include "multio/server/ShmRing.h"
+
+namespace multio {
+namespace server {
+
+// MPI transport that bypasses MPI for clients and servers on the same host. Every co-located
+// client-server pair shares a ring buffer in POSIX shared memory, into which the client writes
+// each message directly, in the same layout as an MPI buffer; the server copies it out into a pool
+// buffer and decodes it like any buffer received through MPI. Servers sleep on a futex when no
+// ring has data. All other pairs communicate through MPI as usual.
+//
+// Setting up the rings is collective: all ranks of the group must construct the transport.
+
+class ShmTransport final : public MpiTransport {
+public:
+    ShmTransport(const eckit::Configuration& config);
+    ~ShmTransport();
+
+private:
+    void send(const Message& msg) override;
+
+    void bufferedSend(const Message& msg) override;
+
+    void listen() override;
+
+    void consumed(const Message& msg) override;
+
+    void print(std::ostream& os) const override;
+
+    void connect(const eckit::Configuration& config);
+
+    void write(ShmRing& ring, const Message& msg);
+
+    bool pollRings();
+    bool anyReadable() const;
+
+    std::vector<SharedSegment> doorbells_;
+    Doorbell* doorbell_ = nullptr;  // Servers only
+
+    std::vector<std::unique_ptr<ShmRing>> inbound_;
+    std::map<Peer, std::unique_ptr<ShmRing>> outbound_;
+    std::set<size_t> localClients_;
+    size_t remoteClients_ = 0;
+    size_t next_ = 0;
+
+    MpiBuffer scratch_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
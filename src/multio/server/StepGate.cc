@@ -0,0 +1,65 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "StepGate.h"
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/io/Buffer.h"
+
+namespace multio {
+namespace server {
+
+using message::Message;
+
+bool StepGate::gathered(const Message& msg) {
+    return msg.tag() == Message::Tag::StepComplete && msg.metadata().has("flushCount");
+}
+
+message::Payload StepGate::expectation(const std::vector<unsigned long>& pairs) {
+    ASSERT(pairs.size() % 2 == 0);
+    return eckit::Buffer{reinterpret_cast<const char*>(pairs.data()),
+                         pairs.size() * sizeof(unsigned long)};
+}
+
+bool StepGate::arrived(const Message& msg) {
+    if (gathered(msg)) {
+        held_.push_back(msg);
+        return false;
+    }
+    ++received_[msg.source().id()];
+    return true;
+}
+
+bool StepGate::ready() const {
+    if (held_.empty()) {
+        return false;
+    }
+
+    const auto& msg = held_.front();
+    auto expected = static_cast<const unsigned long*>(msg.payload().data());
+    auto count = msg.size() / sizeof(unsigned long);
+    for (auto ii = 0ul; ii + 1 < count; ii += 2) {
+        auto it = received_.find(expected[ii]);
+        if ((it == std::end(received_) ? 0 : it->second) < expected[ii + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Message StepGate::release() {
+    ASSERT(ready());
+    auto msg = held_.front();
+    held_.pop_front();
+    return msg;
+}
+
+}  // namespace server
+}  // namespace multio
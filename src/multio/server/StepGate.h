@@ -0,0 +1,54 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_StepGate_H
+#define multio_server_StepGate_H
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "multio/message/Message.h"
+
+namespace multio {
+namespace server {
+
+// Server side of gathered step completion. A gathered StepComplete carries, for every client, how
+// many messages the server must have received from it before the step is complete; it is held
+// back until they have all arrived. Held steps are released in the order they arrived.
+
+class StepGate {
+public:
+    // Whether `msg` is a StepComplete gathered over the clients
+    static bool gathered(const message::Message& msg);
+
+    // Payload of a gathered StepComplete: pairs of client rank and expected message count
+    static message::Payload expectation(const std::vector<unsigned long>& pairs);
+
+    // Counts `msg` and returns true, or holds it back and returns false if it is a gathered step
+    bool arrived(const message::Message& msg);
+
+    // Whether the oldest held step can be released
+    bool ready() const;
+
+    message::Message release();
+
+private:
+    std::map<size_t, unsigned long> received_;
+    std::deque<message::Message> held_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <vector>
 
+#include "eckit/config/Resource.h"
 #include "eckit/exception/Exceptions.h"
+#include "eckit/maths/Functions.h"
 #include "eckit/mpi/Comm.h"
 
 #include "eckit/types/DateTime.h"
@@ -12,29 +15,52 @@
 namespace multio {
 namespace server {
 
-namespace  {
-std::vector<MpiBuffer> makeBuffers(size_t poolSize, size_t maxBufSize) {
-    std::vector<MpiBuffer> bufs;
-    eckit::Log::info() << " *** Allocating " << poolSize << " buffers of size "
-                       << maxBufSize / 1024 / 1024 << " each" << std::endl;
-    double totMem = 0.0;
-    for (auto ii = 0u; ii < poolSize; ++ii) {
-        bufs.emplace_back(maxBufSize);
-        totMem += maxBufSize;
-    }
-    totMem /= 1024*1024*1024;
-    eckit::Log::info() << " *** Allocated a total of " << totMem << "GiB of memory for this peer"
-                       << std::endl;
-    return bufs;
+namespace {
+
+const size_t defaultInitialPoolSize = 4;
+const size_t defaultMinBufferSize = 1024 * 1024;
+const size_t defaultMessagesPerBuffer = 16;
+const double defaultIdleTimeout = 10.0;  // seconds
+
+size_t round_to_power_of_2(size_t sz) {
+    size_t pow2 = 1;
+    while (pow2 < sz) {
+        pow2 *= 2;
+    }
+    return pow2;
 }
+
 }  // namespace
 
 MpiPeer::MpiPeer(const std::string& comm, size_t rank) : Peer{comm, rank} {}
 MpiPeer::MpiPeer(Peer peer) : Peer{peer} {}
 
 StreamPool::StreamPool(size_t poolSize, size_t maxBufSize, const eckit::mpi::Comm& comm,
-                       TransportStatistics& stats) :
-    comm_{comm}, statistics_{stats}, buffers_(makeBuffers(poolSize, maxBufSize)) {}
+                       TransportStatistics& stats, std::unique_ptr<FlushPolicy> policy) :
+    comm_{comm},
+    statistics_{stats},
+    policy_{std::move(policy)},
+    maxPoolSize_{poolSize},
+    maxBufSize_{maxBufSize},
+    minBufSize_{std::min(maxBufSize, eckit::Resource<size_t>(
+                                         "multioMpiMinBufferSize;$MULTIO_MPI_MIN_BUFFER_SIZE",
+                                         defaultMinBufferSize))},
+    messagesPerBuffer_{eckit::Resource<size_t>(
+        "multioMpiMessagesPerBuffer;$MULTIO_MPI_MESSAGES_PER_BUFFER", defaultMessagesPerBuffer)},
+    idleTimeout_{eckit::Resource<double>(
+        "multioMpiBufferIdleTimeout;$MULTIO_MPI_BUFFER_IDLE_TIMEOUT", defaultIdleTimeout)},
+    targetBufSize_{minBufSize_} {
+    ASSERT(maxPoolSize_ > 0);
+
+    auto initialSize = std::min(maxPoolSize_, eckit::Resource<size_t>(
+                                                  "multioMpiInitialPoolSize;$MULTIO_MPI_INITIAL_POOL_SIZE",
+                                                  defaultInitialPoolSize));
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto ii = 0u; ii < initialSize; ++ii) {
+        free_.push_back(FreeBuffer{&allocate(), Clock::now()});
+    }
+}
 
 MpiBuffer& StreamPool::buffer(size_t idx) {
     return buffers_[idx];
@@ -43,36 +69,94 @@ MpiBuffer& StreamPool::buffer(size_t idx) {
 MpiOutputStream& StreamPool::getStream(const message::Message& msg) {
     auto dest = msg.destination();
 
+    // Keeps the send times fed to the flush policy close to when the sends actually completed
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        reclaimOldest();
+    }
+
+    adapt(eckit::round(msg.size(), 8) * messagesPerBuffer_);
+
     if (streams_.find(dest) == std::end(streams_)) {
         return createNewStream(dest);
     }
 
-    //  Carry on using stream if
-    //    * can fit this message into the the stream's buffer AND
-    //    * a probablistic algorithm return true
-    //  The algorithm returns true if buffer is less than 50% filled up, and false if 100% filled up
-    //  It returns either true of false depending on whether a randomly chosen number between 0.5
-    //  and 1.0 is smaller than the fill-up ratio
-
     auto& strm = streams_.at(dest);
-    if (strm.shallFitMessage(msg.size())) {
+    if (not strm.canFitMessage(msg.size())) {
+        flush(dest, static_cast<int>(msg.tag()), FlushReason::full);
+    }
+    else if (not policy_->shallFit(batch(strm), msg.size())) {
+        flush(dest, static_cast<int>(msg.tag()), FlushReason::policy);
+    }
+    else {
         return strm;
     }
 
-    sendBuffer(dest, static_cast<int>(msg.tag()));
+    return createNewStream(dest);
+}
+
+void StreamPool::messageWritten(const message::Message& msg) {
+    auto& strm = streams_.at(msg.destination());
+    strm.messageWritten();
 
-    return replaceStream(dest);
+    if (policy_->flushAfter(batch(strm), msg)) {
+        flush(msg.destination(), static_cast<int>(msg.tag()), FlushReason::policy);
+    }
 }
 
-MpiOutputStream& StreamPool::replaceStream(const message::Peer& dest) {
-    streams_.erase(dest);
-    return createNewStream(dest);
+void StreamPool::flush(const message::Peer& dest, int msg_tag) {
+    flush(dest, msg_tag, FlushReason::forced);
+}
+
+const FlushPolicy& StreamPool::flushPolicy() const {
+    return *policy_;
+}
+
+size_t StreamPool::availableCount() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return free_.size() + (maxPoolSize_ - buffers_.size());
+}
+
+size_t StreamPool::size() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return buffers_.size();
+}
+
+size_t StreamPool::capacity() const {
+    return maxPoolSize_;
+}
+
+size_t StreamPool::maxBufferSize() const {
+    return maxBufSize_;
+}
+
+void StreamPool::adapt(size_t demand) {
+    // Exponentially weighted average over the last few dozen observations
+    std::lock_guard<std::mutex> lock{mutex_};
+    averageDemand_ += (static_cast<double>(demand) - averageDemand_) / 32.0;
+    auto target = round_to_power_of_2(static_cast<size_t>(averageDemand_));
+    targetBufSize_ = std::max(minBufSize_, std::min(maxBufSize_, target));
+}
+
+void StreamPool::flush(const message::Peer& dest, int msg_tag, FlushReason reason) {
+    auto it = streams_.find(dest);
+    if (it == std::end(streams_)) {
+        return;
+    }
+
+    policy_->flushed(batch(it->second), reason);
+    sendBuffer(dest, msg_tag);
+    streams_.erase(it);
+}
+
+Batch StreamPool::batch(const MpiOutputStream& strm) const {
+    return Batch{strm.position(), strm.buffer().content.size(), strm.messageCount(), strm.opened()};
 }
 
 void StreamPool::sendBuffer(const message::Peer& dest, int msg_tag) {
     auto& strm = streams_.at(dest);
 
-    auto sz = static_cast<size_t>(strm.bytesWritten());
+    auto sz = strm.finalise();
     auto destId = static_cast<int>(dest.id());
 
     ++counter_[dest];
@@ -85,10 +169,27 @@ void StreamPool::sendBuffer(const message::Peer& dest, int msg_tag) {
         << ", timestamps: " << eckit::DateTime{static_cast<double>(tstamp.tv_sec)}.time().now()
         << ":" << std::setw(6) << std::setfill('0') << mSecs;
 
-    eckit::AutoTiming(statistics_.timer_, statistics_.isendTiming_);
-
-    strm.buffer().request = comm_.iSend<void>(strm.buffer().content, sz, destId, msg_tag);
-    strm.buffer().status = BufferStatus::transmitting;
+    if (sz > maxBufSize_) {
+        // Rare enough that sending the parts one after the other will do
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.sendTiming_};
+        send(strm.buffer().content, sz, destId, msg_tag);
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            countPoolBytes();
+        }
+        release(strm.buffer());
+    }
+    else {
+        {
+            eckit::AutoTiming timing{statistics_.timer_, statistics_.isendTiming_};
+            strm.buffer().request = comm_.iSend<void>(strm.buffer().content, sz, destId, msg_tag);
+        }
+        strm.buffer().status = BufferStatus::transmitting;
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        countPoolBytes();
+        inFlight_.push_back(InFlight{&strm.buffer(), sz, Clock::now()});
+    }
 
     ::gettimeofday(&tstamp, 0);
     mSecs = tstamp.tv_usec;
@@ -99,44 +200,210 @@ void StreamPool::sendBuffer(const message::Peer& dest, int msg_tag) {
     statistics_.isendSize_ += sz;
 }
 
-MpiBuffer& StreamPool::findAvailableBuffer(std::ostream& os) {
-    eckit::AutoTiming(statistics_.timer_, statistics_.waitTiming_);
+void StreamPool::send(const void* frame, size_t sz, int dest, int msg_tag) {
+    if (sz <= maxBufSize_) {
+        comm_.send<void>(frame, sz, dest, msg_tag);
+        return;
+    }
+
+    std::vector<char> part;
+    FramePart where{static_cast<uint64_t>(comm_.rank()), sz, 0};
+    while (where.offset != sz) {
+        where.offset += MpiOutputStream::writePart(frame, where, maxBufSize_, part);
+        ASSERT(part.size() <= maxBufSize_);
+        comm_.send<void>(part.data(), part.size(), dest, msg_tag);
+        ++statistics_.framePartCount_;
+    }
+}
+
+MpiBuffer& StreamPool::findAvailableBuffer(size_t minSize, std::ostream& os) {
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.waitTiming_};
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (free_.empty()) {
+        reclaimCompleted();
+    }
+
+    if (free_.empty() && buffers_.size() < maxPoolSize_) {
+        free_.push_back(FreeBuffer{&allocate(), Clock::now()});
+    }
 
-    auto it = std::end(buffers_);
-    while (it == std::end(buffers_)) {
-        it = std::find_if(std::begin(buffers_), std::end(buffers_),
-                          [](MpiBuffer& buf) { return buf.isFree(); });
+    while (free_.empty()) {
+        ++statistics_.bufferWaitCount_;
+        if (inFlight_.empty()) {
+            released_.wait(lock, [this]() { return not free_.empty(); });
+        }
+        else {
+            waitAnyInFlight(lock);
+        }
     }
 
-    it->status = BufferStatus::fillingUp;
+    shrinkIdle();
+
+    // The most recently released buffer is the most likely to still be in cache and to be of the
+    // right size; idle buffers collect at the front and are shrunk there
+    auto buf = free_.back().buffer;
+    free_.pop_back();
+    buf->status = BufferStatus::fillingUp;
+
+    resize(*buf, std::max(minSize, targetBufSize_));
 
-    os << " *** Found available buffer with idx = "
-       << static_cast<size_t>(std::distance(std::begin(buffers_), it)) << std::endl;
+    statistics_.poolPeakInUse_ = std::max(statistics_.poolPeakInUse_, buffers_.size() - free_.size());
+
+    os << " *** Found available buffer -- " << free_.size() << " free, " << inFlight_.size()
+       << " in flight, " << buffers_.size() << " allocated" << std::endl;
+
+    return *buf;
+}
 
-    return *it;
+void StreamPool::release(MpiBuffer& buf) {
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        buf.status = BufferStatus::available;
+        free_.push_back(FreeBuffer{&buf, Clock::now()});
+    }
+    released_.notify_one();
 }
 
 void StreamPool::waitAll() {
-    eckit::AutoTiming(statistics_.timer_, statistics_.waitTiming_);
-    while (not std::all_of(std::begin(buffers_), std::end(buffers_),
-                           [](MpiBuffer& buf) { return buf.isFree(); })) {}
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.drainTiming_};
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    std::vector<eckit::mpi::Request> requests;
+    for (const auto& sent : inFlight_) {
+        requests.push_back(sent.buffer->request);
+    }
+
+    // Only the sending thread adds to the in-flight queue, so it cannot change while unlocked
+    lock.unlock();
+    if (not requests.empty()) {
+        comm_.waitAll(requests);
+    }
+    lock.lock();
+
+    for (const auto& sent : inFlight_) {
+        reclaim(sent, false);
+    }
+    inFlight_.clear();
+}
+
+size_t StreamPool::reclaimCompleted() {
+    size_t count = 0;
+    auto it = std::begin(inFlight_);
+    while (it != std::end(inFlight_)) {
+        if (not it->buffer->request.test()) {
+            ++it;
+            continue;
+        }
+        reclaim(*it, false);
+        it = inFlight_.erase(it);
+        ++count;
+    }
+    return count;
+}
+
+void StreamPool::reclaimOldest() {
+    while (not inFlight_.empty() && inFlight_.front().buffer->request.test()) {
+        reclaim(inFlight_.front(), true);
+        inFlight_.pop_front();
+    }
+}
+
+void StreamPool::waitAnyInFlight(std::unique_lock<std::mutex>& lock) {
+    std::vector<eckit::mpi::Request> requests;
+    for (const auto& sent : inFlight_) {
+        requests.push_back(sent.buffer->request);
+    }
+
+    lock.unlock();
+    int idx = 0;
+    comm_.waitAny(requests, idx);
+    lock.lock();
+
+    ASSERT(0 <= idx && static_cast<size_t>(idx) < inFlight_.size());
+    auto it = std::begin(inFlight_) + idx;
+    reclaim(*it, false);
+    inFlight_.erase(it);
+}
+
+void StreamPool::reclaim(const InFlight& sent, bool observed) {
+    auto now = Clock::now();
+    if (observed) {
+        policy_->completed(sent.size, std::chrono::duration<double>(now - sent.sent).count());
+    }
+
+    sent.buffer->status = BufferStatus::available;
+    free_.push_back(FreeBuffer{sent.buffer, now});
+    ++statistics_.reclaimCount_;
+}
+
+MpiBuffer& StreamPool::allocate() {
+    buffers_.emplace_back(targetBufSize_);
+
+    statistics_.poolBuffers_ = buffers_.size();
+    countPoolBytes();
+
+    return buffers_.back();
+}
+
+void StreamPool::resize(MpiBuffer& buf, size_t sz) {
+    auto current = buf.content.size();
+
+    // Leave some slack either way, so that buffers do not keep changing size with small variations
+    if (current < sz) {
+        ++statistics_.bufferGrowCount_;
+    }
+    else if (current > 2 * sz) {
+        ++statistics_.bufferShrinkCount_;
+    }
+    else {
+        return;
+    }
+
+    buf.content.resize(sz, false);
+    countPoolBytes();
+}
+
+// Counted rather than tracked, as streams also grow their buffer when a message does not fit
+void StreamPool::countPoolBytes() {
+    size_t total = 0;
+    for (const auto& buf : buffers_) {
+        total += buf.content.size();
+    }
+    statistics_.poolBytes_ = total;
+    statistics_.poolPeakBytes_ = std::max(statistics_.poolPeakBytes_, total);
+}
+
+void StreamPool::shrinkIdle() {
+    // Only looks at the buffer that has been free for the longest, so this stays O(1) per request
+    auto& oldest = free_.front();
+    if (oldest.buffer->content.size() <= minBufSize_ ||
+        std::chrono::duration<double>(Clock::now() - oldest.since).count() < idleTimeout_) {
+        return;
+    }
+
+    resize(*oldest.buffer, minBufSize_);
+    oldest.since = Clock::now();
 }
 
 MpiOutputStream& StreamPool::createNewStream(const message::Peer& dest) {
-    if (buffers_.size() < streams_.size()) {
+    if (maxPoolSize_ < streams_.size()) {
         throw eckit::BadValue("Too few buffers to cover all MPI destinations", Here());
     }
 
-    auto& buf = findAvailableBuffer(eckit::Log::debug<LibMultio>());
+    auto& buf = findAvailableBuffer();
     streams_.emplace(dest, buf);
 
     return streams_.at(dest);
 }
 
 void StreamPool::print(std::ostream& os) const {
-    os << "StreamPool(size=" << buffers_.size() << ",status=";
+    std::lock_guard<std::mutex> lock{mutex_};
+    os << "StreamPool(size=" << buffers_.size() << ",capacity=" << maxPoolSize_
+       << ",targetBufferSize=" << targetBufSize_ << ",free=" << free_.size()
+       << ",inFlight=" << inFlight_.size() << ",status=";
     std::for_each(std::begin(buffers_), std::end(buffers_),
-                  [&os](const MpiBuffer& buf) { os << static_cast<unsigned>(buf.status); });
+                  [&os](const MpiBuffer& buf) { os << static_cast<unsigned>(buf.status.load()); });
     os << ")";
 }
 }
@@ -2,10 +2,16 @@
 #ifndef multio_server_StreamPool_H
 #define multio_server_StreamPool_H
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 #include "multio/LibMultio.h"
 #include "multio/message/Message.h"
+#include "multio/server/FlushPolicy.h"
 #include "multio/server/MpiStream.h"
 #include "multio/server/TransportStatistics.h"
 
@@ -18,24 +24,84 @@ public:
     MpiPeer(const std::string& comm, size_t rank);
 };
 
+// Buffers are either free, being filled up or read from, or in flight. Free buffers are kept in a
+// list and handed out in O(1). Buffers being sent are queued in the order they were dispatched and
+// reclaimed as their requests complete; when no buffer is free, the caller blocks in MPI (or, on
+// the receiving side, until a reader releases one) rather than polling.
+//
+// The pool starts with a few small buffers and allocates more, up to its capacity, only when none
+// is free. Buffers are resized when handed out, towards a target that follows the observed message
+// sizes, and buffers left idle for long are shrunk back to the minimum size.
+
 class StreamPool {
 public:
     explicit StreamPool(size_t poolSize, size_t maxBufSize, const eckit::mpi::Comm& comm,
-                        TransportStatistics& stats);
+                        TransportStatistics& stats, std::unique_ptr<FlushPolicy> policy);
 
     MpiBuffer& buffer(size_t idx);
 
+    // Stream to write `msg` to; sends the current buffer first if the flush policy says so
     MpiOutputStream& getStream(const message::Message& msg);
 
-    void sendBuffer(const message::Peer& dest, int msg_tag);
+    // To be called once `msg` has been written to the stream returned by getStream
+    void messageWritten(const message::Message& msg);
+
+    // Sends whatever is buffered for `dest`
+    void flush(const message::Peer& dest, int msg_tag);
+
+    // Sends a frame of `sz` bytes, cut into parts if it is longer than the largest buffer, and
+    // returns once it has gone
+    void send(const void* frame, size_t sz, int dest, int msg_tag);
+
+    const FlushPolicy& flushPolicy() const;
+
+    // The buffer holds at least `minSize` bytes
+    MpiBuffer& findAvailableBuffer(size_t minSize = 0,
+                                   std::ostream& os = eckit::Log::debug<LibMultio>());
 
-    MpiBuffer& findAvailableBuffer(std::ostream& os = eckit::Log::debug<LibMultio>());
+    // Returns a buffer that has been read from to the free list; may be called from any thread
+    void release(MpiBuffer& buf);
+
+    // Free buffers, including those that can still be allocated
+    size_t availableCount() const;
+    size_t size() const;
+    size_t capacity() const;
+
+    size_t maxBufferSize() const;
+
+    // Feeds the number of bytes a buffer should hold into the target buffer size
+    void adapt(size_t demand);
 
     void waitAll();
 
 private:
+    struct InFlight {
+        MpiBuffer* buffer;
+        size_t size;
+        std::chrono::steady_clock::time_point sent;
+    };
+
     MpiOutputStream& createNewStream(const message::Peer& dest);
-    MpiOutputStream& replaceStream(const message::Peer& dest);
+
+    void flush(const message::Peer& dest, int msg_tag, FlushReason reason);
+    void sendBuffer(const message::Peer& dest, int msg_tag);
+
+    Batch batch(const MpiOutputStream& strm) const;
+
+    // Moves completed sends, oldest first, to the free list. Caller must hold the mutex.
+    size_t reclaimCompleted();
+    // Same, but stops at the first send still in flight; cheap enough to call for every message
+    void reclaimOldest();
+    void waitAnyInFlight(std::unique_lock<std::mutex>& lock);
+    // `observed` when the send was checked on right up to its completion, so that the time it took
+    // is known; sends found complete late, or waited for, would make the network look slower
+    void reclaim(const InFlight& sent, bool observed);
+
+    // Caller must hold the mutex
+    MpiBuffer& allocate();
+    void resize(MpiBuffer& buf, size_t sz);
+    void countPoolBytes();
+    void shrinkIdle();
 
     void print(std::ostream& os) const;
 
@@ -44,11 +110,34 @@ private:
         return os;
     }
 
+    using Clock = std::chrono::steady_clock;
+
+    struct FreeBuffer {
+        MpiBuffer* buffer;
+        Clock::time_point since;
+    };
+
     const eckit::mpi::Comm& comm_;
     TransportStatistics& statistics_;
-    std::vector<MpiBuffer> buffers_;
+    std::unique_ptr<FlushPolicy> policy_;
+
+    const size_t maxPoolSize_;
+    const size_t maxBufSize_;
+    const size_t minBufSize_;
+    const size_t messagesPerBuffer_;
+    const double idleTimeout_;
+
+    double averageDemand_ = 0.0;
+    size_t targetBufSize_;
+
+    std::deque<MpiBuffer> buffers_;  // MpiBuffer is not movable
     std::map<MpiPeer, MpiOutputStream> streams_;
 
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    std::deque<FreeBuffer> free_;
+    std::deque<InFlight> inFlight_;
+
     std::map<MpiPeer, unsigned int> counter_;
     std::ostringstream os_;
 };
@@ -6,5 +6,39 @@ namespace server {
 
 StreamQueue::StreamQueue() {}
 
+MpiInputStream* StreamQueue::front() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    cv_.wait(lock, [this]() { return closed_ || not queue_.empty(); });
+    return frontOrNull();
+}
+
+MpiInputStream* StreamQueue::front(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    cv_.wait_for(lock, timeout, [this]() { return closed_ || not queue_.empty(); });
+    return frontOrNull();
+}
+
+void StreamQueue::pop() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    queue_.pop();
+}
+
+void StreamQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool StreamQueue::closed() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return closed_;
+}
+
+MpiInputStream* StreamQueue::frontOrNull() {
+    return queue_.empty() ? nullptr : &queue_.front();
+}
+
 }  // namespace server
 }  // namespace multio
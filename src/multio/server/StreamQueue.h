@@ -2,6 +2,9 @@
 #ifndef multio_server_StreamQueue_H
 #define multio_server_StreamQueue_H
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <queue>
 
 #include "multio/server/MpiStream.h"
@@ -9,33 +12,45 @@
 namespace multio {
 namespace server {
 
+// Hands received buffers from the listening thread to the decoding thread. Consumers block until a
+// stream is available, the timeout expires or the queue is closed, instead of polling. The
+// listening thread closes the queue when it stops.
+
 class StreamQueue {
 public:
     StreamQueue();
 
-    MpiInputStream* front() {
-        std::lock_guard<std::mutex> lock{mutex_};
-        if (queue_.empty()) {
-            return nullptr;
-        }
-        auto& strm = queue_.front();
-        return &strm;
-    }
+    // Blocks until a stream is available; returns nullptr once the queue is closed and drained
+    MpiInputStream* front();
 
-    void pop() {
-        front()->buffer().status = BufferStatus::available;
-        queue_.pop();
-    }
+    // As above, but also returns nullptr if nothing arrives within `timeout`
+    MpiInputStream* front(std::chrono::milliseconds timeout);
+
+    // The buffer is returned to the pool once the messages decoded from it are released
+    void pop();
 
     template <typename... Args>
     void emplace(Args&&... args) {
-        std::lock_guard<std::mutex> lock{mutex_};
-        queue_.emplace(std::forward<Args>(args)...);
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            queue_.emplace(std::forward<Args>(args)...);
+        }
+        cv_.notify_one();
     }
 
+    // Wakes up all waiting consumers; streams already queued can still be consumed
+    void close();
+
+    bool closed() const;
+
 private:
+    MpiInputStream* frontOrNull();
+
     std::queue<MpiInputStream> queue_;
-    std::mutex mutex_;
+    bool closed_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
 };
 
 }  // namespace server
@@ -10,48 +10,98 @@
 
 #include "TcpTransport.h"
 
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 #include "eckit/config/LocalConfiguration.h"
+#include "eckit/exception/Exceptions.h"
 #include "eckit/log/Plural.h"
-#include "eckit/maths/Functions.h"
 #include "eckit/runtime/Main.h"
 #include "eckit/serialisation/MemoryStream.h"
 
+#include "multio/message/BufferPool.h"
+#include "multio/util/logfile_name.h"
+
 namespace multio {
 namespace server {
 
 namespace {
-Message decodeMessage(eckit::Stream& stream) {
-    unsigned t;
-    stream >> t;
 
-    std::string src_grp;
-    stream >> src_grp;
-    size_t src_id;
-    stream >> src_id;
+const size_t defaultBatchSize = 1024 * 1024;
+
+// Payloads smaller than this are copied next to their header rather than given their own iovec
+const size_t copyThreshold = 4 * 1024;
+
+const int maxEvents = 64;
+const int waitTimeout = 5000;  // milliseconds
 
-    std::string dest_grp;
-    stream >> dest_grp;
-    size_t dest_id;
-    stream >> dest_id;
+struct FrameHeader {
+    uint64_t headerSize;
+    uint64_t payloadSize;  // As sent
+    uint64_t rawSize;      // Before compression
+    uint64_t flags;        // PayloadCodec::Flags
+};
+
+// Appends whatever is written to it to a byte vector
+class ArenaStream : public eckit::Stream {
+public:
+    explicit ArenaStream(std::vector<char>& arena) : arena_{arena} {}
+
+private:
+    long write(const void* data, long len) override {
+        auto bytes = static_cast<const char*>(data);
+        arena_.insert(std::end(arena_), bytes, bytes + len);
+        return len;
+    }
 
-    std::string fieldId;
-    stream >> fieldId;
+    long read(void*, long) override { throw eckit::NotImplemented(Here()); }
 
-    unsigned long sz;
-    stream >> sz;
+    std::string name() const override { return "ArenaStream"; }
 
-    eckit::Buffer buffer(sz);
-    stream >> buffer;
+    std::vector<char>& arena_;
+};
+
+void write_fully(int fd, std::vector<::iovec>& iov) {
+    size_t idx = 0;
+    while (idx < iov.size()) {
+        auto count = static_cast<int>(std::min<size_t>(iov.size() - idx, IOV_MAX));
+        auto written = ::writev(fd, &iov[idx], count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw eckit::FailedSystemCall("writev", Here());
+        }
+
+        // Skip what has been written, which may end part-way through an iovec
+        auto remaining = static_cast<size_t>(written);
+        while (idx < iov.size() && remaining >= iov[idx].iov_len) {
+            remaining -= iov[idx].iov_len;
+            ++idx;
+        }
+        if (remaining != 0) {
+            iov[idx].iov_base = static_cast<char*>(iov[idx].iov_base) + remaining;
+            iov[idx].iov_len -= remaining;
+        }
+    }
+}
 
-    return Message{Message::Header{static_cast<Message::Tag>(t), TcpPeer{src_grp, src_id},
-                                TcpPeer{dest_grp, dest_id}, std::move(fieldId)},
-                std::move(buffer)};
+eckit::LocalConfiguration flushConfiguration(const eckit::Configuration& cfg) {
+    return cfg.has("flush") ? cfg.getSubConfiguration("flush") : eckit::LocalConfiguration{};
 }
-}  // namespace
 
+}  // namespace
 
 TcpPeer::TcpPeer(const std::string& host, size_t port) : Peer{host, port} {}
 TcpPeer::TcpPeer(const std::string& host, int port) : Peer{host, static_cast<size_t>(port)} {}
@@ -64,27 +114,71 @@ size_t TcpPeer::port() const {
     return id_;
 }
 
-struct Connection {
-    eckit::Select& select_;
-    eckit::net::TCPSocket socket_;
-
-    Connection(eckit::Select& select, eckit::net::TCPSocket& socket) :
-        select_{select},
-        socket_{socket} {
-        select_.add(socket_);
-    }
-
-    ~Connection() {
-        select_.remove(socket_);
-        socket_.close();
+// One outgoing socket and the messages batched for it. Segments either refer to the arena, which
+// holds frame headers, message headers and small payloads, or to a payload kept alive in `held`.
+struct Outgoing {
+    struct Segment {
+        size_t offset;
+        const void* data;
+        size_t size;
+    };
+
+    std::unique_ptr<eckit::net::TCPSocket> socket;
+
+    std::vector<char> arena;
+    std::vector<Segment> segments;
+    std::vector<message::Payload> held;
+
+    size_t bytesHeld = 0;
+    size_t messages = 0;
+    std::chrono::steady_clock::time_point opened;
+
+    size_t size() const { return arena.size() + bytesHeld; }
+
+    void clear() {
+        arena.clear();
+        segments.clear();
+        held.clear();
+        messages = 0;
+        bytesHeld = 0;
     }
+};
 
-    bool ready() { return select_.set(socket_); }
+// One incoming socket. It is read without blocking, so the frame being read is kept here until it
+// is complete: first its frame header, then the message header, then the payload.
+struct Connection {
+    enum class Part
+    {
+        frame,
+        header,
+        payload
+    };
+
+    std::unique_ptr<eckit::net::TCPSocket> socket_;
+    std::deque<Message> pending_;
+    bool registered_ = false;
+
+    Part part_ = Part::frame;
+    size_t got_ = 0;  // Bytes of the current part read so far
+    FrameHeader frame_{};
+    std::vector<char> header_;
+    message::Payload payload_;
+
+    explicit Connection(eckit::net::TCPSocket& socket) :
+        socket_{new eckit::net::TCPSocket{socket}} {}
+
+    int fd() const { return socket_->socket(); }
 };
 
 TcpTransport::TcpTransport(const eckit::Configuration& config) :
     Transport(config),
-    local_{"localhost", config.getUnsigned("local_port")} {
+    local_{"localhost", config.getUnsigned("local_port")},
+    stripes_{config.getUnsigned("stripes", 1)},
+    batchSize_{flushConfiguration(config).getUnsigned("batchSize", defaultBatchSize)},
+    policy_{FlushPolicyFactory::instance().build(flushConfiguration(config))},
+    codec_{config, statistics_} {
+    ASSERT(stripes_ > 0);
+
     auto serverConfigs = config.getSubConfigurations("servers");
 
     for (auto cfg : serverConfigs) {
@@ -94,26 +188,52 @@ TcpTransport::TcpTransport(const eckit::Configuration& config) :
         if (amIServer(host, ports)) {
             server_.reset(new eckit::net::TCPServer{static_cast<int>(local_.port()),
                                                     eckit::net::SocketOptions::server()});
-            select_.add(*server_);
+
+            epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_ < 0) {
+                throw eckit::FailedSystemCall("epoll_create1", Here());
+            }
+
+            ::epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = server_->socket();
+            if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, event.data.fd, &event) < 0) {
+                throw eckit::FailedSystemCall("epoll_ctl", Here());
+            }
         }
         else {
             // TODO: assert that (local_.host(), local_.port()) is in the list of clients
             for (const auto port : ports) {
                 try {
-                    eckit::net::TCPClient client;
-                    std::unique_ptr<eckit::net::TCPSocket> socket{
-                        new eckit::net::TCPSocket{client.connect(host, port, 5, 10)}};
-                    outgoing_.emplace(TcpPeer{host, port}, std::move(socket));
+                    auto& stripes = outgoing_[TcpPeer{host, port}];
+                    for (auto ii = 0u; ii < stripes_; ++ii) {
+                        eckit::net::TCPClient client;
+                        std::unique_ptr<Outgoing> out{new Outgoing{}};
+                        out->socket.reset(
+                            new eckit::net::TCPSocket{client.connect(host, port, 5, 10)});
+                        stripes.push_back(std::move(out));
+                    }
                 }
                 catch (eckit::TooManyRetries& e) {
                     eckit::Log::error() << "Failed to establish connection to host: " << host
                                         << ", port: " << port << std::endl;
+                    outgoing_.erase(TcpPeer{host, port});
                 }
             }
         }
     }
 }
 
+TcpTransport::~TcpTransport() {
+    if (epoll_ >= 0) {
+        ::close(epoll_);
+    }
+
+    std::ofstream logFile{util::logfile_name(), std::ios_base::app};
+    logFile << "\n ** " << *this << "\n";
+    statistics_.report(logFile);
+    policy_->report(logFile);
+}
 
 void TcpTransport::openConnections() {
     for (auto& server : createServerPeers()) {
@@ -129,59 +249,220 @@ void TcpTransport::closeConnections() {
     }
 }
 
-Message TcpTransport::nextMessage(eckit::net::TCPSocket& socket) const {
-    size_t size;
-    socket.read(&size, sizeof(size));
+bool TcpTransport::readFrame(Connection& conn) {
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.receiveTiming_};
+
+    for (;;) {
+        char* data = nullptr;
+        size_t size = 0;
+        switch (conn.part_) {
+            case Connection::Part::frame:
+                data = reinterpret_cast<char*>(&conn.frame_);
+                size = sizeof(conn.frame_);
+                break;
+            case Connection::Part::header:
+                data = conn.header_.data();
+                size = conn.header_.size();
+                break;
+            case Connection::Part::payload:
+                data = static_cast<char*>(conn.payload_.data());
+                size = conn.payload_.size();
+                break;
+        }
+
+        if (conn.got_ < size) {
+            auto count = ::read(conn.fd(), data + conn.got_, size - conn.got_);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return false;
+                }
+                throw eckit::FailedSystemCall("read", Here());
+            }
+            if (count == 0) {
+                throw eckit::SeriousBug(
+                    "TcpTransport: connection closed by the client before Close", Here());
+            }
+            conn.got_ += static_cast<size_t>(count);
+            continue;
+        }
+
+        // The current part is complete
+        conn.got_ = 0;
+        switch (conn.part_) {
+            case Connection::Part::frame:
+                conn.header_.resize(conn.frame_.headerSize);
+                conn.part_ = Connection::Part::header;
+                break;
+            case Connection::Part::header:
+                if (conn.frame_.payloadSize != 0) {
+                    conn.payload_ =
+                        message::BufferPool::instance().allocate(conn.frame_.payloadSize);
+                    conn.part_ = Connection::Part::payload;
+                    break;
+                }
+                conn.part_ = Connection::Part::frame;
+                return true;
+            case Connection::Part::payload:
+                conn.part_ = Connection::Part::frame;
+                return true;
+        }
+    }
+}
+
+Message TcpTransport::decodeFrame(Connection& conn) {
+    const auto& frame = conn.frame_;
+
+    eckit::MemoryStream stream{conn.header_.data(), conn.header_.size()};
+    auto hdr = Message::Header::decode(stream);
+
+    auto payload = std::move(conn.payload_);
+    conn.payload_ = message::Payload{};
 
-    eckit::Buffer buffer{size};
-    socket.read(buffer, static_cast<long>(size));
+    if (frame.flags != PayloadCodec::raw) {
+        payload = codec_.decode(static_cast<unsigned char>(frame.flags), payload.data(),
+                                payload.size(), frame.rawSize);
+    }
 
-    eckit::MemoryStream stream{buffer};
+    ++statistics_.receiveCount_;
+    statistics_.receiveSize_ += sizeof(frame) + frame.headerSize + frame.payloadSize;
 
-    return decodeMessage(stream);
+    return Message{std::move(hdr), std::move(payload)};
 }
 
 Message TcpTransport::receive() {
+    while (ready_.empty()) {
+        waitForEvents();
+    }
 
-    waitForEvent();
+    auto msg = ready_.front();
+    ready_.pop();
+    return msg;
+}
 
-    for (auto it = begin(incoming_); it != end(incoming_); ++it) {
-        if (not (*it)->ready()) {
-            continue;
+void TcpTransport::send(const Message& msg) {
+    for (auto out : stripesFor(msg)) {
+        // Anything batched for this connection goes first
+        if (out->messages != 0) {
+            flush(*out, FlushReason::forced);
+        }
+        append(*out, msg);
+        writeBatch(*out);
+    }
+}
+
+void TcpTransport::bufferedSend(const Message& msg) {
+    for (auto out : stripesFor(msg)) {
+        auto sz = msg.size();
+        if (out->messages != 0) {
+            Batch batch{out->size(), batchSize_, out->messages, out->opened};
+            if (out->size() + sz > batchSize_) {
+                flush(*out, FlushReason::full);
+            }
+            else if (not policy_->shallFit(batch, sz)) {
+                flush(*out, FlushReason::policy);
+            }
         }
 
-        auto msg = nextMessage((*it)->socket_);
+        append(*out, msg);
 
-        if(msg.tag() == Message::Tag::Close) {
-            incoming_.erase(it);
-        } else {
-            std::swap(*it, incoming_[incoming_.size() - 1]);
+        // Servers cannot finish a step before all of it has arrived, whatever the policy
+        if (msg.tag() == Message::Tag::StepComplete || msg.tag() == Message::Tag::Close) {
+            flush(*out, FlushReason::forced);
         }
+        else if (policy_->flushAfter(Batch{out->size(), batchSize_, out->messages, out->opened},
+                                     msg)) {
+            flush(*out, FlushReason::policy);
+        }
+    }
+}
+
+std::vector<Outgoing*> TcpTransport::stripesFor(const Message& msg) {
+    auto& stripes = outgoing_.at(msg.destination());
 
-        return msg;
+    if (msg.tag() == Message::Tag::Field) {
+        return {stripes[msg.fieldKey().field() % stripes.size()].get()};
     }
 
-    throw eckit::SeriousBug("No message received");
+    std::vector<Outgoing*> all;
+    for (auto& out : stripes) {
+        all.push_back(out.get());
+    }
+    return all;
 }
 
-void TcpTransport::send(const Message& msg) {
-    const auto& socket = outgoing_.at(msg.destination());
+void TcpTransport::append(Outgoing& out, const Message& msg) {
+    if (out.messages == 0) {
+        out.opened = std::chrono::steady_clock::now();
+    }
+
+    auto offset = out.arena.size();
+    out.arena.resize(offset + sizeof(FrameHeader));
 
-    // Add 4K for header/footer etc. Should be plenty
-    eckit::Buffer buffer{eckit::round(msg.size(), 8) + 4096};
+    {
+        eckit::AutoTiming timing{statistics_.timer_, statistics_.encodeTiming_};
+        ArenaStream strm{out.arena};
+        msg.header().encode(strm);
+    }
+
+    auto encoded = codec_.encode(msg);
+
+    FrameHeader frame{out.arena.size() - offset - sizeof(FrameHeader), encoded.size, msg.size(),
+                      encoded.flags};
+    std::memcpy(out.arena.data() + offset, &frame, sizeof(frame));
+
+    const auto& payload = msg.payload();
+    if (encoded.flags != PayloadCodec::raw) {
+        // The codec reuses its output buffer for the next message
+        auto bytes = static_cast<const char*>(encoded.data);
+        out.arena.insert(std::end(out.arena), bytes, bytes + encoded.size);
+        out.segments.push_back(Outgoing::Segment{offset, nullptr, out.arena.size() - offset});
+    }
+    else if (payload.borrowed() || payload.size() < copyThreshold) {
+        // Borrowed memory may be reused as soon as this call returns
+        auto bytes = static_cast<const char*>(payload.data());
+        out.arena.insert(std::end(out.arena), bytes, bytes + payload.size());
+        out.segments.push_back(Outgoing::Segment{offset, nullptr, out.arena.size() - offset});
+    }
+    else {
+        out.segments.push_back(Outgoing::Segment{offset, nullptr, out.arena.size() - offset});
+        out.segments.push_back(Outgoing::Segment{0, payload.data(), payload.size()});
+        out.held.push_back(payload);
+        out.bytesHeld += payload.size();
+    }
 
-    eckit::MemoryStream stream{buffer};
+    ++out.messages;
+}
 
-    msg.encode(stream);
+void TcpTransport::flush(Outgoing& out, FlushReason reason) {
+    policy_->flushed(Batch{out.size(), batchSize_, out.messages, out.opened}, reason);
 
-    auto size = stream.bytesWritten();
-    socket->write(&size, sizeof(size));
+    auto start = std::chrono::steady_clock::now();
+    auto sz = out.size();
+    writeBatch(out);
 
-    socket->write(buffer, static_cast<int>(size));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    policy_->completed(sz, std::chrono::duration<double>(elapsed).count());
 }
 
-void TcpTransport::bufferedSend(const Message&) {
-    throw eckit::NotImplemented{Here()};
+void TcpTransport::writeBatch(Outgoing& out) {
+    eckit::AutoTiming timing{statistics_.timer_, statistics_.sendTiming_};
+
+    std::vector<::iovec> iov;
+    iov.reserve(out.segments.size());
+    for (const auto& seg : out.segments) {
+        auto data = seg.data ? seg.data : out.arena.data() + seg.offset;
+        iov.push_back(::iovec{const_cast<void*>(data), seg.size});
+    }
+
+    write_fully(out.socket->socket(), iov);
+
+    ++statistics_.sendCount_;
+    statistics_.sendSize_ += out.size();
+
+    out.clear();
 }
 
 Peer TcpTransport::localPeer() const {
@@ -201,28 +482,130 @@ PeerList TcpTransport::createServerPeers() {
 }
 
 void TcpTransport::print(std::ostream& os) const {
-    os << "TcpTransport()";
+    os << "TcpTransport(stripes=" << stripes_ << ", " << *policy_ << ")";
 }
 
-bool TcpTransport::acceptConnection() {
-    if (not select_.set(*server_)) {
-        return false;
+void TcpTransport::acceptConnection() {
+    eckit::net::TCPSocket socket{server_->accept()};
+    std::unique_ptr<Connection> conn{new Connection{socket}};
+
+    ::epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = conn->fd();
+    if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, event.data.fd, &event) < 0) {
+        throw eckit::FailedSystemCall("epoll_ctl", Here());
     }
 
-    eckit::net::TCPSocket socket{server_->accept()};
-    incoming_.emplace_back(new Connection{select_, socket});
+    // Read without blocking, so that one slow client does not hold up the others
+    auto flags = ::fcntl(event.data.fd, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(event.data.fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw eckit::FailedSystemCall("fcntl", Here());
+    }
 
-    return true;
+    incoming_.emplace(event.data.fd, std::move(conn));
 }
 
-void TcpTransport::waitForEvent() {
-    do {
-        while (not select_.ready(5)) {
-            eckit::Log::info() << "Waiting... There are "
-                               << eckit::Plural(incoming_.size(), "connection") << " still active"
-                               << std::endl;
+void TcpTransport::waitForEvents() {
+    ::epoll_event events[maxEvents];
+
+    int count = 0;
+    while ((count = ::epoll_wait(epoll_, events, maxEvents, waitTimeout)) == 0) {
+        eckit::Log::info() << "Waiting... There are "
+                           << eckit::Plural(incoming_.size(), "connection") << " still active"
+                           << std::endl;
+    }
+
+    if (count < 0) {
+        if (errno == EINTR) {
+            return;
         }
-    } while (acceptConnection());
+        throw eckit::FailedSystemCall("epoll_wait", Here());
+    }
+
+    for (auto ii = 0; ii < count; ++ii) {
+        auto fd = events[ii].data.fd;
+        if (fd == server_->socket()) {
+            acceptConnection();
+            continue;
+        }
+
+        // A client may have been closed by an earlier event in this batch
+        auto it = incoming_.find(fd);
+        if (it != std::end(incoming_)) {
+            readFrom(*it->second);
+        }
+    }
+}
+
+void TcpTransport::readFrom(Connection& conn) {
+    auto fd = conn.fd();
+    while (readFrame(conn)) {
+        auto msg = decodeFrame(conn);
+        auto client = msg.source();
+
+        if (not conn.registered_) {
+            clients_[client].push_back(&conn);
+            conn.registered_ = true;
+        }
+
+        conn.pending_.push_back(std::move(msg));
+        deliver(client);
+
+        // Gone once the client has closed
+        if (incoming_.find(fd) == std::end(incoming_)) {
+            return;
+        }
+    }
+}
+
+void TcpTransport::deliver(const Peer& client) {
+    auto& stripes = clients_.at(client);
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        // Fields can go as soon as they have arrived
+        for (auto conn : stripes) {
+            auto& pending = conn->pending_;
+            while (not pending.empty() && pending.front().tag() == Message::Tag::Field) {
+                ready_.push(std::move(pending.front()));
+                pending.pop_front();
+                progress = true;
+            }
+        }
+
+        // Anything else only once it has arrived on every stripe
+        if (stripes.size() < stripes_ ||
+            std::any_of(std::begin(stripes), std::end(stripes),
+                        [](const Connection* conn) { return conn->pending_.empty(); })) {
+            return;
+        }
+
+        auto msg = stripes.front()->pending_.front();
+        for (auto conn : stripes) {
+            ASSERT(conn->pending_.front().tag() == msg.tag());
+            conn->pending_.pop_front();
+        }
+        ready_.push(msg);
+        progress = true;
+
+        if (msg.tag() == Message::Tag::Close) {
+            closeClient(client);
+            return;
+        }
+    }
+}
+
+void TcpTransport::closeClient(const Peer& client) {
+    for (auto conn : clients_.at(client)) {
+        ASSERT(conn->pending_.empty());
+        auto fd = conn->fd();
+        ::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        conn->socket_->close();
+        incoming_.erase(fd);
+    }
+    clients_.erase(client);
 }
 
 bool TcpTransport::amIServer(const std::string& host, std::vector<size_t> ports) {
@@ -17,14 +17,18 @@
 #ifndef multio_server_TcpTransport_H
 #define multio_server_TcpTransport_H
 
+#include <deque>
 #include <iosfwd>
 #include <map>
+#include <memory>
+#include <queue>
 #include <vector>
 
 #include "eckit/net/TCPClient.h"
 #include "eckit/net/TCPServer.h"
-#include "eckit/io/Select.h"
 
+#include "multio/server/FlushPolicy.h"
+#include "multio/server/PayloadCodec.h"
 #include "multio/server/Transport.h"
 
 namespace eckit {
@@ -47,10 +51,23 @@ public:
 };
 
 struct Connection;
+struct Outgoing;
+
+// Each message is framed by the sizes of its header and payload, so that payloads can be written
+// straight from the caller's memory with writev and read straight into a pooled buffer. Servers
+// read without blocking and keep partly read frames per connection, so a slow client does not
+// hold up the others.
+//
+// Buffered messages are batched per connection; when a batch is sent is decided by the 'flush'
+// policy, with 'batchSize' (default 1 MiB) as the batch capacity. With 'stripes: N', clients open N
+// connections to every server. Fields are spread over them by field; all other messages are sent
+// on every stripe and act as barriers: the server only delivers one once it has arrived on all of
+// a client's stripes, which keeps fields in order with respect to the control messages around them.
 
 class TcpTransport final : public Transport {
 public:
     TcpTransport(const eckit::Configuration& config);
+    ~TcpTransport();
 
 private:
     void openConnections() override;
@@ -68,21 +85,42 @@ private:
 
     void print(std::ostream& os) const override;
 
-    Message nextMessage(eckit::net::TCPSocket& socket) const;
+    // Sending
+    std::vector<Outgoing*> stripesFor(const Message& msg);
+    void append(Outgoing& out, const Message& msg);
+    void flush(Outgoing& out, FlushReason reason);
+    void writeBatch(Outgoing& out);
 
-    bool acceptConnection();
-    void waitForEvent();
+    // Receiving: reads what has arrived of a connection's current frame, without blocking;
+    // returns true once the frame is complete and can be decoded
+    bool readFrame(Connection& conn);
+    Message decodeFrame(Connection& conn);
+
+    void acceptConnection();
+    void waitForEvents();
+    void readFrom(Connection& conn);
+    void deliver(const Peer& client);
+    void closeClient(const Peer& client);
 
     bool amIServer(const std::string& host, std::vector<size_t> ports);
 
     TcpPeer local_;
 
-    std::map<Peer, const std::unique_ptr<eckit::net::TCPSocket>> outgoing_;
+    const size_t stripes_;
+    const size_t batchSize_;
+    std::unique_ptr<FlushPolicy> policy_;
+
+    PayloadCodec codec_;
 
-    eckit::Select select_;
+    std::map<Peer, std::vector<std::unique_ptr<Outgoing>>> outgoing_;
+
+    int epoll_ = -1;
 
     std::unique_ptr<eckit::net::TCPServer> server_;
-    std::vector<std::unique_ptr<Connection>> incoming_;
+    std::map<int, std::unique_ptr<Connection>> incoming_;
+    std::map<Peer, std::vector<Connection*>> clients_;
+
+    std::queue<Message> ready_;
 };
 
 }  // namespace server
@@ -10,6 +10,9 @@
 
 #include "ThreadTransport.h"
 
+#include <atomic>
+#include <utility>
+
 #include "eckit/config/Resource.h"
 #include "eckit/exception/Exceptions.h"
 
@@ -18,6 +21,14 @@
 namespace multio {
 namespace server {
 
+namespace {
+
+// Distinguishes transports in the per-thread routing tables, even if one is allocated where
+// another used to be
+std::atomic<size_t> transport_count{0};
+
+}  // namespace
+
 ThreadPeer::ThreadPeer(std::thread t) :
     Peer{"thread", std::hash<std::thread::id>{}(t.get_id())},
     thread_{std::move(t)} {}
@@ -26,7 +37,8 @@ ThreadPeer::ThreadPeer(std::thread t) :
 ThreadTransport::ThreadTransport(const eckit::Configuration& cfg) :
     Transport(cfg),
     messageQueueSize_(
-        eckit::Resource<size_t>("multioMessageQueueSize;$MULTIO_MESSAGE_QUEUE_SIZE", 1024)) {}
+        eckit::Resource<size_t>("multioMessageQueueSize;$MULTIO_MESSAGE_QUEUE_SIZE", 1024)),
+    id_{transport_count++} {}
 
 void ThreadTransport::openConnections() {
     throw eckit::NotImplemented{Here()};
@@ -40,18 +52,19 @@ Message ThreadTransport::receive() {
 
     Peer receiver = localPeer();
 
-    auto& queue = receiveQueue(receiver);
+    auto& queue = route(receiver);
 
     Message msg;
 
-    ASSERT(queue.pop(msg) >= 0);
+    ASSERT(queue.pop(msg));
     ASSERT(msg.destination() == receiver);
 
     return msg;
 }
 
 void ThreadTransport::send(const Message& msg) {
-    receiveQueue(msg.destination()).push(msg);
+    // The message outlives this call, so it cannot keep referring to borrowed memory
+    route(msg.destination()).push(msg.own());
 }
 
 void ThreadTransport::bufferedSend(const Message&) {
@@ -70,7 +83,18 @@ void ThreadTransport::print(std::ostream& os) const {
     os << "ThreadTransport(number of queues = " << queues_.size() << ")";
 }
 
-eckit::Queue<Message>& ThreadTransport::receiveQueue(Peer dest) {
+ThreadTransport::MessageQueue& ThreadTransport::route(const Peer& dest) {
+    thread_local std::map<std::pair<size_t, Peer>, MessageQueue*> routes;
+
+    auto key = std::make_pair(id_, dest);
+    auto it = routes.find(key);
+    if (it == end(routes)) {
+        it = routes.emplace(key, &receiveQueue(dest)).first;
+    }
+    return *it->second;
+}
+
+ThreadTransport::MessageQueue& ThreadTransport::receiveQueue(const Peer& dest) {
 
     std::unique_lock<std::mutex> locker(mutex_);
 
@@ -79,7 +103,7 @@ eckit::Queue<Message>& ThreadTransport::receiveQueue(Peer dest) {
         return *qitr->second;
     }
 
-    queues_.emplace(dest, std::unique_ptr<eckit::Queue<Message>>{new eckit::Queue<Message>(messageQueueSize_)});
+    queues_.emplace(dest, std::unique_ptr<MessageQueue>{new MessageQueue(messageQueueSize_)});
 
     eckit::Log::debug<LibMultio>()
         << "ADD QUEUE for " << dest << " --- " << queues_.at(dest).get() << std::endl;
@@ -21,8 +21,7 @@
 #include <mutex>
 #include <thread>
 
-#include "eckit/container/Queue.h"
-
+#include "multio/server/RingQueue.h"
 #include "multio/server/ScopedThread.h"
 #include "multio/server/Transport.h"
 
@@ -58,13 +57,21 @@ private:
 
     PeerList createServerPeers() override;
 
-    eckit::Queue<Message>& receiveQueue(Peer to);
+    using MessageQueue = MpscQueue<Message>;
+
+    // Resolved once per thread and destination, on the first message sent, i.e. when opening the
+    // connection; later messages go straight to the queue without locking
+    MessageQueue& route(const Peer& to);
 
-    std::map<Peer, std::unique_ptr<eckit::Queue<Message>>> queues_;
+    MessageQueue& receiveQueue(const Peer& to);
+
+    std::map<Peer, std::unique_ptr<MessageQueue>> queues_;
 
     std::mutex mutex_;
 
     size_t messageQueueSize_;
+
+    const size_t id_;
 };
 
 }  // namespace server
@@ -30,6 +30,22 @@ Transport::Transport(const eckit::Configuration& config) : config_{config} {}
 
 void Transport::listen() {}
 
+void Transport::stopListening() {}
+
+void Transport::consumed(const Message&) {}
+
+void Transport::sendStepComplete(const message::Metadata& md, const PeerList& servers) {
+    for (auto& server : servers) {
+        Message msg{Message::Header{Message::Tag::StepComplete, localPeer(), *server,
+                                    message::Metadata{md}}};
+        bufferedSend(msg);
+    }
+}
+
+std::vector<ServerLoad> Transport::serverLoads(const PeerList& servers) {
+    return std::vector<ServerLoad>(servers.size());
+}
+
 //--------------------------------------------------------------------------------------------------
 
 TransportFactory& TransportFactory::instance() {
@@ -24,6 +24,7 @@
 
 #include "eckit/memory/NonCopyable.h"
 #include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
 
 #include "multio/message/Message.h"
 #include "multio/server/TransportStatistics.h"
@@ -36,6 +37,12 @@ using message::Peer;
 
 using PeerList = std::vector<std::unique_ptr<message::Peer>>;
 
+// How far behind a server was when it last told a client
+struct ServerLoad {
+    size_t backlog = 0;  // Bytes received but not yet taken on for processing
+    double lag = 0;      // Seconds since the oldest of those bytes arrived
+};
+
 //----------------------------------------------------------------------------------------------------------------------
 
 class Transport {
@@ -47,6 +54,7 @@ public:  // methods
     virtual void openConnections() = 0;
     virtual void closeConnections() = 0;
 
+    // Server side: the next message, or one tagged Empty once the transport has stopped listening
     virtual Message receive() = 0;
 
     virtual void send(const Message& message) = 0;
@@ -57,8 +65,24 @@ public:  // methods
 
     virtual void listen();
 
+    // Server side: called by the listening thread once it stops, after the last client has closed
+    virtual void stopListening();
+
+    // Called, possibly from another thread, once a received message has been taken on for
+    // processing; transports with flow control return the sender's credit here
+    virtual void consumed(const Message& message);
+
+    // Client side: the loads last reported by `servers`, where servers that have not reported count
+    // as idle. All clients must place fields alike, so this is collective over the clients, which
+    // all get the view of the first one.
+    virtual std::vector<ServerLoad> serverLoads(const PeerList& servers);
+
     virtual PeerList createServerPeers() = 0;
 
+    // Client side: tells every one of `servers` that this client has completed a step, by default
+    // with a StepComplete message to each
+    virtual void sendStepComplete(const message::Metadata& md, const PeerList& servers);
+
 protected:
     const eckit::LocalConfiguration config_;
 
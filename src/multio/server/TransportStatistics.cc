@@ -9,6 +9,21 @@ TransportStatistics::TransportStatistics() {}
 void multio::server::TransportStatistics::report(std::ostream& out, const char* indent) const {
     
     reportTime(out, "    -- Waiting for buffer", waitTiming_, indent);
+    reportCount(out, "    -- Blocked on buffer", bufferWaitCount_, indent);
+    reportCount(out, "    -- Buffers reclaimed", reclaimCount_, indent);
+    reportTime(out, "    -- Draining sends", drainTiming_, indent);
+
+    reportCount(out, "    -- Buffers allocated", poolBuffers_, indent);
+    reportCount(out, "    -- Peak buffers in use", poolPeakInUse_, indent);
+    reportBytes(out, "    -- Buffer memory", poolBytes_, indent);
+    reportBytes(out, "    -- Peak buffer memory", poolPeakBytes_, indent);
+    reportCount(out, "    -- Buffers grown", bufferGrowCount_, indent);
+    reportCount(out, "    -- Buffers shrunk", bufferShrinkCount_, indent);
+
+    reportCount(out, "    -- Stalled on credit", creditStallCount_, indent);
+    reportTime(out, "    -- Waiting for credit", creditStallTiming_, indent);
+    reportCount(out, "    -- Credit grants sent", creditGrantCount_, indent);
+    reportBytes(out, "    -- Credit granted", creditGrantSize_, indent);
 
     reportCount(out, "    -- Send count (async)", isendCount_, indent);
     reportBytes(out, "    -- Sending data (async)", isendSize_, indent);
@@ -20,10 +35,27 @@ void multio::server::TransportStatistics::report(std::ostream& out, const char*
     if (sendTiming_.elapsed_) {
         reportRate(out, "    -- Send rate (block)", sendSize_ / sendTiming_.elapsed_, indent);
     }
+    reportCount(out, "    -- Frame parts sent", framePartCount_, indent);
 
     reportTime(out, "    -- Serialise data", encodeTiming_, indent);
 
+    reportCount(out, "    -- Payloads compressed", compressCount_, indent);
+    reportCount(out, "    -- Payloads incompressible", incompressibleCount_, indent);
+    reportBytes(out, "    -- Compression input", compressInSize_, indent);
+    reportBytes(out, "    -- Compression output", compressOutSize_, indent);
+    if (compressOutSize_) {
+        reportUnit(out, "    -- Compression ratio", "",
+                   static_cast<double>(compressInSize_) / compressOutSize_, indent);
+    }
+    reportTime(out, "    -- Compressing data", compressTiming_, indent);
+
+    reportCount(out, "    -- Shared-memory send count", shmSendCount_, indent);
+    reportBytes(out, "    -- Shared-memory sent", shmSendSize_, indent);
+    reportCount(out, "    -- Shared-memory receive count", shmReceiveCount_, indent);
+    reportBytes(out, "    -- Shared-memory received", shmReceiveSize_, indent);
+
     reportTime(out, "    -- Probing for data", probeTiming_, indent);
+    reportTime(out, "    -- Idle between probes", idleTiming_, indent);
     reportCount(out, "    -- Receive count", receiveCount_, indent);
     reportBytes(out, "    -- Receiving data", receiveSize_, indent);
     reportTime(out, "    -- Receive timing", receiveTiming_, indent);
@@ -33,6 +65,10 @@ void multio::server::TransportStatistics::report(std::ostream& out, const char*
 
     reportTime(out, "    -- Push-queue timing", pushToQueueTiming_, indent);
     reportTime(out, "    -- Deserialise data", decodeTiming_, indent);
+    reportCount(out, "    -- Payloads sliced", zeroCopyCount_, indent);
+    reportCount(out, "    -- Payloads copied", payloadCopyCount_, indent);
+    reportCount(out, "    -- Payloads decompressed", decompressCount_, indent);
+    reportTime(out, "    -- Decompressing data", decompressTiming_, indent);
     reportTime(out, "    -- Returning data", returnTiming_, indent);
     reportTime(out, "    -- Total for return", totReturnTiming_, indent);
 }
@@ -19,16 +19,52 @@ public:
     std::size_t sendCount_ = 0;
     std::size_t sendSize_ = 0;
 
+    std::size_t framePartCount_ = 0;
+
     std::size_t receiveCount_ = 0;
     std::size_t receiveSize_ = 0;
 
+    std::size_t shmSendCount_ = 0;
+    std::size_t shmSendSize_ = 0;
+    std::size_t shmReceiveCount_ = 0;
+    std::size_t shmReceiveSize_ = 0;
+
+    std::size_t zeroCopyCount_ = 0;
+    std::size_t payloadCopyCount_ = 0;
+
+    std::size_t bufferWaitCount_ = 0;
+    std::size_t reclaimCount_ = 0;
+
+    std::size_t poolBuffers_ = 0;
+    std::size_t poolPeakInUse_ = 0;
+    std::size_t poolBytes_ = 0;
+    std::size_t poolPeakBytes_ = 0;
+    std::size_t bufferGrowCount_ = 0;
+    std::size_t bufferShrinkCount_ = 0;
+
+    std::size_t creditStallCount_ = 0;
+    std::size_t creditGrantCount_ = 0;
+    std::size_t creditGrantSize_ = 0;
+
+    std::size_t compressCount_ = 0;
+    std::size_t incompressibleCount_ = 0;
+    std::size_t compressInSize_ = 0;
+    std::size_t compressOutSize_ = 0;
+    std::size_t decompressCount_ = 0;
+
     eckit::Timing waitTiming_;
+    eckit::Timing drainTiming_;
+
+    eckit::Timing creditStallTiming_;
 
     eckit::Timing isendTiming_;
     eckit::Timing sendTiming_;
     eckit::Timing encodeTiming_;
+    eckit::Timing compressTiming_;
+    eckit::Timing decompressTiming_;
 
     eckit::Timing probeTiming_;
+    eckit::Timing idleTiming_;
     eckit::Timing receiveTiming_;
     eckit::Timing pushToQueueTiming_;
     eckit::Timing decodeTiming_;
@@ -0,0 +1,97 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include "WeightedPlacement.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "eckit/config/Configuration.h"
+#include "eckit/exception/Exceptions.h"
+
+#include "multio/LibMultio.h"
+#include "multio/message/FieldKey.h"
+
+namespace multio {
+namespace server {
+
+WeightedPlacement::WeightedPlacement(const eckit::Configuration& config, size_t serverCount) :
+    plans_(action::plan_outlines(config)), weights_(serverCount) {
+    ASSERT(serverCount != 0);
+
+    if (config.has("inventory")) {
+        placeInventory(config);
+    }
+}
+
+size_t WeightedPlacement::place(const message::Metadata& metadata) {
+    auto field = message::FieldKey{metadata}.field();
+    auto it = placed_.find(field);
+    if (it != end(placed_)) {
+        return it->second;
+    }
+    return assign(field, fieldWeight(metadata));
+}
+
+// A plan costs one for every field it selects, plus one for every statistics operation it runs on
+// it, as those keep state on the server for every field
+double WeightedPlacement::fieldWeight(const message::Metadata& metadata) const {
+    auto cost = plans_.empty() ? 1.0 : 0.0;
+    for (const auto& plan : plans_) {
+        if (plan.selects(metadata)) {
+            cost += 1.0 + static_cast<double>(plan.statisticsCount);
+        }
+    }
+
+    return static_cast<double>(metadata.getLong("globalSize", 1)) *
+           static_cast<double>(metadata.getLong("levelCount", 1)) * cost;
+}
+
+// Longest-processing-time-first: the heaviest fields are placed first, each on the server with the
+// least weight so far
+void WeightedPlacement::placeInventory(const eckit::Configuration& config) {
+    std::vector<std::pair<double, message::Metadata>> fields;
+    for (const auto& cfg : config.getSubConfigurations("inventory")) {
+        auto metadata = message::to_metadata(cfg);
+        fields.emplace_back(fieldWeight(metadata), std::move(metadata));
+    }
+
+    std::stable_sort(begin(fields), end(fields),
+                     [](const std::pair<double, message::Metadata>& lhs,
+                        const std::pair<double, message::Metadata>& rhs) {
+                         return lhs.first > rhs.first;
+                     });
+
+    for (const auto& field : fields) {
+        auto key = message::FieldKey{field.second}.field();
+        if (placed_.find(key) == end(placed_)) {
+            assign(key, field.first);
+        }
+    }
+
+    eckit::Log::debug<multio::LibMultio>()
+        << "WeightedPlacement: placed " << placed_.size() << " fields from the inventory"
+        << std::endl;
+}
+
+size_t WeightedPlacement::lightestServer() const {
+    return static_cast<size_t>(
+        std::distance(begin(weights_), std::min_element(begin(weights_), end(weights_))));
+}
+
+size_t WeightedPlacement::assign(std::uint64_t field, double weight) {
+    auto id = lightestServer();
+    weights_[id] += weight;
+    placed_.emplace(field, id);
+    return id;
+}
+
+}  // namespace server
+}  // namespace multio
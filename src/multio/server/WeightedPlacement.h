@@ -0,0 +1,62 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+/// @date Oct 2026
+
+#ifndef multio_server_WeightedPlacement_H
+#define multio_server_WeightedPlacement_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "multio/action/Plan.h"
+#include "multio/message/Metadata.h"
+
+namespace eckit {
+class Configuration;
+}  // namespace eckit
+
+namespace multio {
+namespace server {
+
+// Placement of fields on servers by weight, i.e. by how much data and work a field brings to the
+// server that processes it. Fields listed in an optional `inventory` are placed up front, heaviest
+// first; any other field goes to the server with the least weight so far when it is first seen.
+// Placements are sticky and depend only on the configuration and the order fields are seen in,
+// so all clients agree on them.
+
+class WeightedPlacement {
+public:
+    WeightedPlacement(const eckit::Configuration& config, size_t serverCount);
+
+    // Index of the server for the field
+    size_t place(const message::Metadata& metadata);
+
+    // Global size times levels times the cost of the plans that select the field
+    double fieldWeight(const message::Metadata& metadata) const;
+
+    const std::vector<double>& weights() const { return weights_; }
+
+private:
+    void placeInventory(const eckit::Configuration& config);
+    size_t lightestServer() const;
+    size_t assign(std::uint64_t field, double weight);
+
+    std::vector<action::PlanOutline> plans_;
+
+    std::vector<double> weights_;
+    std::map<std::uint64_t, size_t> placed_;
+};
+
+}  // namespace server
+}  // namespace multio
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "eccodes.h"
 
+#include "eckit/config/LocalConfiguration.h"
 #include "eckit/config/YAMLConfiguration.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/io/StdFile.h"
@@ -54,6 +55,11 @@ size_t& root() {
     return rt;
 }
 
+// Transports running clients and servers as ranks of an MPI communicator
+bool mpi_based(const std::string& transport) {
+    return transport == "mpi" || transport == "mpi-rma";
+}
+
 bool& new_random_data_each_run() {
     static bool val = false;
     return val;
@@ -169,7 +175,7 @@ std::vector<double>& global_test_field(const std::string& field_id, const size_t
         return test_fields[field_id];
     }
 
-    if (transport == "mpi" && new_random_data_each_run()) {
+    if (mpi_based(transport) && new_random_data_each_run()) {
         test_fields[field_id] =
             (root() == list_id) ? create_random_data(sz) : std::vector<double>(sz);
         comm().broadcast(test_fields[field_id], root());
@@ -195,6 +201,7 @@ eckit::LocalConfiguration test_configuration(const std::string& type) {
     eckit::Log::debug<multio::LibMultio>() << "Transport type: " << type << std::endl;
 
     std::map<std::string, std::string> configs = {{"mpi", "mpi-test-configuration"},
+                                                  {"mpi-rma", "mpi-rma-test-configuration"},
                                                   {"tcp", "tcp-test-configuration"},
                                                   {"thread", "thread-test-configuration"},
                                                   {"none", "no-transport-test-configuration"}};
@@ -330,7 +337,7 @@ void MultioHammer::init(const eckit::option::CmdArgs& args) {
     config_.set("clientCount", clientCount_).set("serverCount", serverCount_);
 
     transportType_ = config_.getString("transport");
-    if (transportType_ == "mpi") {
+    if (mpi_based(transportType_)) {
         auto comm_size = eckit::mpi::comm(config_.getString("group").c_str()).size();
         if (comm_size != clientCount_ + serverCount_) {
             throw eckit::SeriousBug(
@@ -457,7 +464,7 @@ void MultioHammer::execute(const eckit::option::CmdArgs& args) {
     if (transportType_ == "none") {
         executePlans(args);
     }
-    if (transportType_ == "mpi") {
+    if (mpi_based(transportType_)) {
         executeMpi();
     }
     if (transportType_ == "tcp") {
@@ -477,7 +484,7 @@ bool MultioHammer::skipTest() {
         doTest = true;
     }
 
-    if (transportType_ == "mpi") {
+    if (mpi_based(transportType_)) {
         eckit::mpi::comm().barrier();
         doTest = (eckit::mpi::comm().rank() == root());
     }
@@ -520,7 +527,7 @@ void MultioHammer::testData() {
 }
 
 void MultioHammer::executeMpi() {
-    std::shared_ptr<Transport> transport{TransportFactory::instance().build("mpi", config_)};
+    std::shared_ptr<Transport> transport{TransportFactory::instance().build(transportType_, config_)};
 
     auto comm = config_.getString("group");
 
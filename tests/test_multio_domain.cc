@@ -0,0 +1,100 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "multio/domain/Domain.h"
+#include "multio/message/BufferPool.h"
+#include "multio/message/Message.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Message;
+using message::Metadata;
+using message::Peer;
+
+namespace {
+
+const long globalSize = 64;
+const long levelCount = 3;
+
+// Long runs, points on their own and short runs, in no particular order
+std::vector<int32_t> index_map() {
+    std::vector<int32_t> map;
+    for (int32_t id = 40; id != 60; ++id) {
+        map.push_back(id);
+    }
+    for (int32_t id : {3, 7, 8, 9, 1}) {
+        map.push_back(id);
+    }
+    for (int32_t id = 10; id != 30; ++id) {
+        map.push_back(id);
+    }
+    map.push_back(63);
+    return map;
+}
+
+Message field(message::Payload payload) {
+    Metadata md;
+    md.set("globalSize", globalSize).set("levelCount", levelCount);
+    return Message{Message::Header{Message::Tag::Field, Peer{}, Peer{}, std::move(md)},
+                   std::move(payload)};
+}
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_unstructured_to_global") {
+    auto map = index_map();
+    auto def = map;
+    auto domain = domain::make_domain("unstructured", std::move(def));
+
+    EXPECT(domain->global_indices() == map);
+
+    std::vector<double> values;
+    for (long lev = 0; lev != levelCount; ++lev) {
+        for (auto id : map) {
+            values.push_back(1000.0 * lev + id);
+        }
+    }
+
+    std::vector<double> expected(globalSize * levelCount, -1.0);
+    for (long lev = 0; lev != levelCount; ++lev) {
+        for (auto id : map) {
+            expected[lev * globalSize + id] = 1000.0 * lev + id;
+        }
+    }
+
+    auto local = field(message::Payload::borrow(values.data(), values.size() * sizeof(double)));
+    auto global = field(message::BufferPool::instance().allocate(expected.size() * sizeof(double)));
+    auto out = static_cast<double*>(global.payload().data());
+    std::fill(out, out + expected.size(), -1.0);
+
+    domain->to_global(local, global);
+
+    EXPECT(std::memcmp(out, expected.data(), expected.size() * sizeof(double)) == 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
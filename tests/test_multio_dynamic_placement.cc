@@ -0,0 +1,114 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <string>
+#include <vector>
+
+#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/testing/Test.h"
+
+#include "multio/server/DynamicPlacement.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Metadata;
+using server::DynamicPlacement;
+using server::ServerLoad;
+
+namespace {
+
+Metadata field(const std::string& name) {
+    Metadata md;
+    md.set("category", "ocean-2d").set("name", name);
+    return md;
+}
+
+// Server 0 reports three seconds of lag, which weighs like four times its field count
+std::vector<ServerLoad> firstLagging() {
+    std::vector<ServerLoad> loads(2);
+    loads[0].lag = 3.0;
+    return loads;
+}
+
+const std::string plans = R"(
+plans:
+  - actions:
+      - type: Select
+        match: field
+        fields: [sst]
+      - type: Statistics
+        operations: [average]
+  - actions:
+      - type: Select
+        match: category
+        categories: [ocean-2d]
+)";
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_load_changes_placement") {
+    DynamicPlacement placement{eckit::YAMLConfiguration{std::string{"{}"}}, 2};
+
+    // No loads yet: fields alternate as with `even`
+    EXPECT_EQUAL(placement.place(field("a")), 0);
+    EXPECT_EQUAL(placement.place(field("b")), 1);
+
+    SECTION("without loads new fields keep alternating") {
+        placement.update(std::vector<ServerLoad>(2));
+        EXPECT_EQUAL(placement.place(field("c")), 0);
+        EXPECT_EQUAL(placement.place(field("d")), 1);
+    }
+
+    SECTION("a lagging server gets fewer new fields") {
+        placement.update(firstLagging());
+        EXPECT_EQUAL(placement.place(field("c")), 1);
+        EXPECT_EQUAL(placement.place(field("d")), 1);
+        EXPECT_EQUAL(placement.place(field("e")), 1);
+        EXPECT_EQUAL(placement.counts()[0], 1);
+        EXPECT_EQUAL(placement.counts()[1], 4);
+
+        // Without plans, every field keeps state and stays where it was first placed
+        EXPECT_EQUAL(placement.place(field("a")), 0);
+    }
+}
+
+CASE("test_fields_without_state_move") {
+    DynamicPlacement placement{eckit::YAMLConfiguration{plans}, 2};
+
+    EXPECT(placement.stateful(field("sst")));
+    EXPECT(not placement.stateful(field("ssh")));
+
+    EXPECT_EQUAL(placement.place(field("sst")), 0);
+    EXPECT_EQUAL(placement.place(field("ssh")), 1);
+    EXPECT_EQUAL(placement.place(field("sss")), 0);
+
+    // Loads taken at the end of the step: only the statistics field stays on the lagging server
+    placement.update(firstLagging());
+    EXPECT_EQUAL(placement.counts()[0], 1);
+    EXPECT_EQUAL(placement.counts()[1], 0);
+
+    EXPECT_EQUAL(placement.place(field("sst")), 0);
+    EXPECT_EQUAL(placement.place(field("ssh")), 1);
+    EXPECT_EQUAL(placement.place(field("sss")), 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
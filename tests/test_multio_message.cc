@@ -0,0 +1,220 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <cstring>
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/io/Buffer.h"
+#include "eckit/serialisation/MemoryStream.h"
+#include "eckit/testing/Test.h"
+
+#include "multio/message/BufferPool.h"
+#include "multio/message/Message.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Message;
+using message::Metadata;
+using message::Peer;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_message_roundtrip") {
+    eckit::LocalConfiguration run;
+    run.set("expver", "xxxx").set("class", "rd");
+
+    Metadata md;
+    md.set("name", "sst")
+        .set("category", "ocean-2d")
+        .set("globalSize", 29l)
+        .set("domainCount", 5)
+        .set("level", 1)
+        .set("missingValue", 9999.0)
+        .set("bitmapPresent", false)
+        .set("levels", std::vector<long>{1, 2, 3})
+        .set("run", run);
+
+    std::vector<double> vals{1.0, 2.0, 3.0, 4.0};
+    eckit::Buffer payload{reinterpret_cast<const char*>(vals.data()), vals.size() * sizeof(double)};
+
+    Message msg{Message::Header{Message::Tag::Field, Peer{"world", 1}, Peer{"world", 6},
+                                std::move(md)},
+                std::move(payload)};
+
+    eckit::Buffer buffer{4096};
+    eckit::MemoryStream ostrm{buffer};
+    msg.encode(ostrm);
+
+    eckit::MemoryStream istrm{buffer};
+    auto res = Message::decode(istrm);
+
+    EXPECT(res.version() == Message::protocolVersion());
+    EXPECT(res.fieldKey() == msg.fieldKey());
+    EXPECT(res.tag() == Message::Tag::Field);
+    EXPECT(res.source() == (Peer{"world", 1}));
+    EXPECT(res.destination() == (Peer{"world", 6}));
+
+    EXPECT_EQUAL(res.name(), "sst");
+    EXPECT_EQUAL(res.category(), "ocean-2d");
+    EXPECT_EQUAL(res.globalSize(), 29);
+    EXPECT_EQUAL(res.domainCount(), 5);
+    EXPECT_EQUAL(res.metadata().getLong("level"), 1);
+    EXPECT_EQUAL(res.metadata().getDouble("missingValue"), 9999.0);
+    EXPECT(not res.metadata().getBool("bitmapPresent"));
+    EXPECT(res.metadata().getLongVector("levels") == (std::vector<long>{1, 2, 3}));
+    EXPECT_EQUAL(res.metadata().getSubConfiguration("run").getString("expver"), "xxxx");
+
+    EXPECT_EQUAL(res.size(), vals.size() * sizeof(double));
+    EXPECT(std::memcmp(res.payload().data(), vals.data(), res.size()) == 0);
+}
+
+CASE("test_borrowed_payload") {
+    std::vector<double> vals{1.0, 2.0, 3.0};
+    auto payload = message::Payload::borrow(vals.data(), vals.size() * sizeof(double));
+
+    EXPECT(payload.borrowed());
+    EXPECT(payload.data() == vals.data());
+
+    Message msg{Message::Header{Message::Tag::Field, Peer{"world", 1}, Peer{"world", 2}},
+                payload};
+
+    SECTION("serialised from the borrowed memory") {
+        eckit::Buffer buffer{1024};
+        eckit::MemoryStream ostrm{buffer};
+        msg.encode(ostrm);
+
+        eckit::MemoryStream istrm{buffer};
+        auto res = Message::decode(istrm);
+
+        EXPECT(not res.payload().borrowed());
+        EXPECT_EQUAL(res.size(), vals.size() * sizeof(double));
+        EXPECT(std::memcmp(res.payload().data(), vals.data(), res.size()) == 0);
+    }
+
+    SECTION("owned copy is independent of the caller's memory") {
+        auto owned = msg.own();
+        vals[0] = 42.0;
+
+        EXPECT(not owned.payload().borrowed());
+        EXPECT(owned.payload().data() != vals.data());
+        EXPECT_EQUAL(static_cast<const double*>(owned.payload().data())[0], 1.0);
+    }
+}
+
+CASE("test_buffer_pool") {
+    auto& pool = message::BufferPool::instance();
+
+    const void* recycled = nullptr;
+    {
+        auto payload = pool.allocate(3 * 1024 * 1024);
+        EXPECT_EQUAL(payload.size(), 3 * 1024 * 1024);
+        EXPECT(not payload.borrowed());
+        recycled = payload.data();
+    }
+
+    // Same size class
+    auto payload = pool.allocate(3 * 1024 * 1024 - 100);
+    EXPECT(payload.data() == recycled);
+}
+
+CASE("test_metadata") {
+    Metadata md;
+    md.set("step", 3).set("name", "sst").set("levels", std::vector<int>{1, 2});
+
+    EXPECT(md.has(Metadata::Key::name));
+    EXPECT(not md.has(Metadata::Key::level));
+    EXPECT_EQUAL(md.getString(Metadata::Key::name), "sst");
+    EXPECT_EQUAL(md.getLong("step"), 3);
+    EXPECT_EQUAL(md.getLong("levelCount", 1), 1);
+    EXPECT(md.getLongVector("levels") == (std::vector<long>{1, 2}));
+    EXPECT_THROWS_AS(md.getString("step"), eckit::BadValue);
+    EXPECT_THROWS_AS(md.getLong("missing"), eckit::UserError);
+
+    SECTION("copies do not share modifications") {
+        Metadata other{md};
+        other.set("name", "sss").set("operation", "average");
+
+        EXPECT_EQUAL(md.getString("name"), "sst");
+        EXPECT(not md.has("operation"));
+        EXPECT_EQUAL(other.getString("name"), "sss");
+        EXPECT_EQUAL(other.size(), 4);
+    }
+
+    SECTION("JSON representation is ordered by key") {
+        EXPECT_EQUAL(message::to_string(md), R"({"levels":[1,2],"name":"sst","step":3})");
+    }
+
+    SECTION("configuration adapters") {
+        auto config = message::to_configuration(md);
+        EXPECT_EQUAL(config.getString("name"), "sst");
+
+        auto res = message::to_metadata(config);
+        EXPECT_EQUAL(res.getLong("step"), 3);
+        EXPECT(res.getLongVector("levels") == (std::vector<long>{1, 2}));
+    }
+}
+
+CASE("test_field_key") {
+    Metadata md;
+    md.set("name", "sst").set("category", "ocean-2d").set("param", 34l).set("level", 1).set("step", 3);
+
+    message::FieldKey key{md};
+    EXPECT_EQUAL(key.step(), 3);
+
+    SECTION("same field, next step") {
+        Metadata next{md};
+        next.set("step", 4).set("globalSize", 29l);
+
+        message::FieldKey nextKey{next};
+        EXPECT(nextKey.field() == key.field());
+        EXPECT(nextKey.identity() == key.identity());
+        EXPECT(nextKey != key);
+    }
+
+    SECTION("different level") {
+        Metadata other{md};
+        other.set("level", 2);
+        EXPECT(message::FieldKey{other}.field() != key.field());
+    }
+
+    SECTION("statistics output") {
+        Metadata other{md};
+        other.set("operation", "average");
+        EXPECT(message::FieldKey{other}.field() != key.field());
+    }
+
+    SECTION("same field on another domain") {
+        Metadata other{md};
+        other.set("domain", "V grid");
+        EXPECT(message::FieldKey{other} != key);
+        EXPECT(message::FieldKey{other}.identity() != key.identity());
+    }
+
+    SECTION("equal hashes alone do not make equal keys") {
+        message::FieldKey lhs{42, 3, "sa"};
+        message::FieldKey rhs{42, 3, "sb"};
+        EXPECT(lhs != rhs);
+        EXPECT((lhs < rhs) != (rhs < lhs));
+        EXPECT(lhs == (message::FieldKey{42, 3, "sa"}));
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
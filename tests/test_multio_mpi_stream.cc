@@ -0,0 +1,86 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "multio/server/MpiStream.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using server::FramePart;
+using server::MpiBuffer;
+using server::MpiInputStream;
+using server::MpiOutputStream;
+
+namespace {
+
+const size_t maxSize = 1024;
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_frame_parts_reassemble") {
+    std::vector<double> values(1000);
+    for (auto ii = 0u; ii != values.size(); ++ii) {
+        values[ii] = 0.5 * ii;
+    }
+
+    MpiBuffer frame{maxSize};
+    MpiOutputStream strm{frame};
+    strm << std::string{"field"};
+    strm.writePayload(message::Payload::borrow(values.data(), values.size() * sizeof(double)));
+    auto sz = strm.finalise();
+
+    EXPECT(sz > maxSize);
+    EXPECT(MpiInputStream::frameSize(frame) == sz);
+
+    FramePart part;
+    const char* data = nullptr;
+    size_t partSize = 0;
+    EXPECT(not MpiInputStream::readPart(frame, part, data, partSize));
+
+    std::vector<char> assembled(sz);
+    std::vector<char> bytes;
+    size_t partCount = 0;
+    FramePart where{3, sz, 0};
+    while (where.offset != sz) {
+        where.offset += MpiOutputStream::writePart(frame.content, where, maxSize, bytes);
+        EXPECT(bytes.size() <= maxSize);
+        ++partCount;
+
+        MpiBuffer received{maxSize};
+        std::memcpy(received.content.data(), bytes.data(), bytes.size());
+        EXPECT(MpiInputStream::frameSize(received) == bytes.size());
+
+        EXPECT(MpiInputStream::readPart(received, part, data, partSize));
+        EXPECT(part.sender == 3);
+        EXPECT(part.frameSize == sz);
+        std::memcpy(assembled.data() + part.offset, data, partSize);
+    }
+
+    EXPECT(partCount > 1);
+    EXPECT(std::memcmp(assembled.data(), frame.content.data(), sz) == 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,123 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/testing/Test.h"
+#include "eckit/utils/Compressor.h"
+
+#include "multio/server/PayloadCodec.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Message;
+using message::Peer;
+using server::PayloadCodec;
+
+namespace {
+
+std::vector<double> smooth_field(size_t size) {
+    std::vector<double> vals(size);
+    for (size_t ii = 0; ii != size; ++ii) {
+        vals[ii] = 273.15 + std::sin(ii / 100.0);
+    }
+    return vals;
+}
+
+Message field_message(const std::vector<double>& vals) {
+    return Message{Message::Header{Message::Tag::Field, Peer{"world", 1}, Peer{"world", 2}},
+                   message::Payload::borrow(vals.data(), vals.size() * sizeof(double))};
+}
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_byte_shuffle") {
+    std::vector<unsigned char> in{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    std::vector<unsigned char> shuffled(in.size());
+    std::vector<unsigned char> out(in.size());
+
+    server::byte_shuffle(in.data(), shuffled.data(), 3, 4);
+    EXPECT(shuffled == (std::vector<unsigned char>{1, 5, 9, 2, 6, 10, 3, 7, 11, 4, 8, 12}));
+
+    server::byte_unshuffle(shuffled.data(), out.data(), 3, 4);
+    EXPECT(out == in);
+}
+
+CASE("test_payload_codec_disabled") {
+    server::TransportStatistics stats;
+    PayloadCodec codec{eckit::LocalConfiguration{}, stats};
+    EXPECT(not codec.enabled());
+
+    auto vals = smooth_field(4096);
+    auto msg = field_message(vals);
+
+    auto encoded = codec.encode(msg);
+    EXPECT_EQUAL(encoded.flags, PayloadCodec::raw);
+    EXPECT(encoded.data == msg.payload().data());
+    EXPECT_EQUAL(encoded.size, msg.size());
+
+    SECTION("unknown compressors are rejected") {
+        eckit::LocalConfiguration cfg;
+        cfg.set("compression", "no-such-compressor");
+        EXPECT_THROWS_AS(PayloadCodec(cfg, stats), eckit::UserError);
+    }
+}
+
+CASE("test_payload_codec_roundtrip") {
+    if (not eckit::CompressorFactory::instance().has("lz4")) {
+        return;
+    }
+
+    eckit::LocalConfiguration cfg;
+    cfg.set("compression", "lz4");
+
+    server::TransportStatistics stats;
+    PayloadCodec codec{cfg, stats};
+    EXPECT(codec.enabled());
+
+    auto vals = smooth_field(64 * 1024);
+    auto msg = field_message(vals);
+
+    auto encoded = codec.encode(msg);
+    EXPECT(encoded.flags & PayloadCodec::compressed);
+    EXPECT(encoded.flags & PayloadCodec::shuffled);
+    EXPECT(encoded.size < msg.size());
+
+    auto payload = codec.decode(encoded.flags, encoded.data, encoded.size, msg.size());
+    EXPECT_EQUAL(payload.size(), msg.size());
+    EXPECT(std::memcmp(payload.data(), vals.data(), payload.size()) == 0);
+
+    SECTION("small and non-field payloads are sent as they are") {
+        std::vector<double> small(16, 1.0);
+        EXPECT_EQUAL(codec.encode(field_message(small)).flags, PayloadCodec::raw);
+
+        Message grib{Message::Header{Message::Tag::Grib, Peer{"world", 1}, Peer{"world", 2}},
+                     message::Payload::borrow(vals.data(), vals.size() * sizeof(double))};
+        EXPECT_EQUAL(codec.encode(grib).flags, PayloadCodec::raw);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,162 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "multio/server/RingQueue.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using server::MpscQueue;
+using server::SpscQueue;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_spsc_queue") {
+    SpscQueue<long> queue{5};
+    EXPECT_EQUAL(queue.capacity(), 8);
+
+    SECTION("bounded") {
+        std::vector<long> vals{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        EXPECT_EQUAL(queue.tryPush(begin(vals), end(vals)), 8);
+        EXPECT(not queue.tryPush(11));
+
+        long val = 0;
+        EXPECT(queue.tryPop(val));
+        EXPECT_EQUAL(val, 1);
+        EXPECT(queue.tryPush(9));
+
+        std::vector<long> batch;
+        EXPECT_EQUAL(queue.pop(batch, 100), 8);
+        EXPECT(batch == (std::vector<long>{2, 3, 4, 5, 6, 7, 8, 9}));
+    }
+
+    SECTION("drained after closing") {
+        queue.push(42);
+        queue.close();
+
+        long val = 0;
+        EXPECT(queue.pop(val));
+        EXPECT_EQUAL(val, 42);
+        EXPECT(not queue.pop(val));
+    }
+
+    SECTION("preserves order across threads") {
+        const long count = 100000;
+        std::thread producer{[&queue, count]() {
+            for (long ii = 0; ii != count; ++ii) {
+                queue.push(long{ii});
+            }
+            queue.close();
+        }};
+
+        long expected = 0;
+        std::vector<long> batch;
+        while (queue.pop(batch, 3) != 0) {
+            for (auto val : batch) {
+                EXPECT_EQUAL(val, expected++);
+            }
+            batch.clear();
+        }
+        producer.join();
+
+        EXPECT_EQUAL(expected, count);
+    }
+}
+
+CASE("test_mpsc_queue") {
+    const long producerCount = 4;
+    const long count = 50000;
+
+    MpscQueue<long> queue{64};
+
+    std::vector<std::thread> producers;
+    for (long id = 0; id != producerCount; ++id) {
+        producers.emplace_back([&queue, id, count]() {
+            std::vector<long> batch;
+            for (long ii = 0; ii != count; ++ii) {
+                batch.push_back(id * count + ii);
+                if (batch.size() == 5) {
+                    queue.push(begin(batch), end(batch));
+                    batch.clear();
+                }
+            }
+            queue.push(begin(batch), end(batch));
+        });
+    }
+
+    std::thread closer{[&queue, &producers]() {
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        queue.close();
+    }};
+
+    // Each producer's values arrive in the order they were sent
+    std::vector<long> last(producerCount, -1);
+    long received = 0;
+    std::vector<long> batch;
+    while (queue.pop(batch, 7) != 0) {
+        for (auto val : batch) {
+            auto id = val / count;
+            EXPECT(val % count == last[id] + 1);
+            last[id] = val % count;
+            ++received;
+        }
+        batch.clear();
+    }
+    closer.join();
+
+    EXPECT_EQUAL(received, producerCount * count);
+}
+
+CASE("test_queued_values_are_owned") {
+    auto value = std::make_shared<long>(42);
+
+    SECTION("only while queued") {
+        SpscQueue<std::shared_ptr<long>> queue{1024};
+        EXPECT_EQUAL(value.use_count(), 1);
+
+        queue.push(std::shared_ptr<long>{value});
+        EXPECT_EQUAL(value.use_count(), 2);
+
+        std::shared_ptr<long> out;
+        EXPECT(queue.tryPop(out));
+        EXPECT_EQUAL(value.use_count(), 2);
+        out.reset();
+        EXPECT_EQUAL(value.use_count(), 1);
+    }
+
+    SECTION("and released with the queue") {
+        {
+            MpscQueue<std::shared_ptr<long>> queue{4};
+            queue.push(std::shared_ptr<long>{value});
+            queue.push(std::shared_ptr<long>{value});
+            EXPECT_EQUAL(value.use_count(), 3);
+        }
+        EXPECT_EQUAL(value.use_count(), 1);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,95 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "multio/server/StepGate.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Message;
+using message::Peer;
+using server::StepGate;
+
+namespace {
+
+Message field(size_t client) {
+    return Message{Message::Header{Message::Tag::Field, Peer{"world", client}, Peer{"world", 0}}};
+}
+
+// Expects `count` messages from each of clients 1 and 2
+Message gathered_step(unsigned long count) {
+    message::Metadata md;
+    md.set("flushCount", 2);
+    return Message{Message::Header{Message::Tag::StepComplete, Peer{"world", 1}, Peer{"world", 0},
+                                   std::move(md)},
+                   StepGate::expectation({1, count, 2, count})};
+}
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_step_gate") {
+    StepGate gate;
+
+    SECTION("other messages pass") {
+        EXPECT(gate.arrived(field(1)));
+        EXPECT(gate.arrived(Message{Message::Header{Message::Tag::StepComplete, Peer{"world", 1},
+                                                    Peer{"world", 0}}}));
+        EXPECT(not gate.ready());
+    }
+
+    SECTION("steps are held until every client's messages have arrived") {
+        EXPECT(gate.arrived(field(1)));
+        EXPECT(not gate.arrived(gathered_step(2)));
+        EXPECT(not gate.ready());
+
+        EXPECT(gate.arrived(field(2)));
+        EXPECT(gate.arrived(field(2)));
+        EXPECT(not gate.ready());
+
+        EXPECT(gate.arrived(field(1)));
+        EXPECT(gate.ready());
+
+        auto msg = gate.release();
+        EXPECT(StepGate::gathered(msg));
+        EXPECT(not gate.ready());
+    }
+
+    SECTION("steps are released in order") {
+        EXPECT(not gate.arrived(gathered_step(1)));
+        EXPECT(not gate.arrived(gathered_step(2)));
+
+        for (size_t client : {1, 2, 1, 2}) {
+            EXPECT(gate.arrived(field(client)));
+        }
+
+        EXPECT(gate.ready());
+        gate.release();
+        EXPECT(gate.ready());
+        gate.release();
+        EXPECT(not gate.ready());
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
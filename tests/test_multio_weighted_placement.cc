@@ -0,0 +1,125 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation nor
+ * does it submit to any jurisdiction.
+ */
+
+#include <string>
+
+#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/testing/Test.h"
+
+#include "multio/server/WeightedPlacement.h"
+
+using namespace eckit::testing;
+
+namespace multio {
+namespace test {
+
+using message::Metadata;
+using server::WeightedPlacement;
+
+namespace {
+
+Metadata field(const std::string& name, long globalSize, long levelCount = 1) {
+    Metadata md;
+    md.set("category", "ocean-2d")
+        .set("name", name)
+        .set("globalSize", globalSize)
+        .set("levelCount", levelCount);
+    return md;
+}
+
+const std::string plans = R"(
+plans:
+  - actions:
+      - type: Select
+        match: field
+        fields: [sst, ssh]
+      - type: Statistics
+        operations: [average, maximum]
+  - actions:
+      - type: Select
+        match: field
+        fields: [sst]
+)";
+
+const std::string inventory = R"(
+inventory:
+  - {category: ocean-2d, name: a, globalSize: 10}
+  - {category: ocean-2d, name: b, globalSize: 40}
+  - {category: ocean-2d, name: c, globalSize: 30}
+  - {category: ocean-2d, name: d, globalSize: 20, levelCount: 2}
+)";
+
+}  // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CASE("test_field_weight") {
+    SECTION("without plans every field costs one per value") {
+        WeightedPlacement placement{eckit::YAMLConfiguration{std::string{"{}"}}, 2};
+        EXPECT_EQUAL(placement.fieldWeight(field("sst", 100, 3)), 300.0);
+    }
+
+    SECTION("plans add their cost to the fields they select") {
+        WeightedPlacement placement{eckit::YAMLConfiguration{plans}, 2};
+
+        // Both plans: 1 + 2 statistics, plus 1
+        EXPECT_EQUAL(placement.fieldWeight(field("sst", 100)), 400.0);
+        // First plan only
+        EXPECT_EQUAL(placement.fieldWeight(field("ssh", 100)), 300.0);
+        // Selected by no plan
+        EXPECT_EQUAL(placement.fieldWeight(field("sss", 100)), 0.0);
+    }
+
+    SECTION("chained selections must all match, as in the plan") {
+        const std::string chained = R"(
+plans:
+  - actions:
+      - type: Select
+        match: category
+        categories: [ocean-2d]
+      - type: Select
+        match: field
+        fields: [sst]
+)";
+        WeightedPlacement placement{eckit::YAMLConfiguration{chained}, 2};
+        EXPECT_EQUAL(placement.fieldWeight(field("sst", 100)), 100.0);
+        EXPECT_EQUAL(placement.fieldWeight(field("ssh", 100)), 0.0);
+    }
+}
+
+CASE("test_inventory_placement") {
+    WeightedPlacement placement{eckit::YAMLConfiguration{inventory}, 2};
+
+    // Heaviest first: b (40) and d (40) on servers 0 and 1, then c (30) and a (10) on the lighter
+    EXPECT_EQUAL(placement.place(field("b", 40)), 0);
+    EXPECT_EQUAL(placement.place(field("d", 20, 2)), 1);
+    EXPECT_EQUAL(placement.place(field("c", 30)), 0);
+    EXPECT_EQUAL(placement.place(field("a", 10)), 1);
+    EXPECT_EQUAL(placement.weights()[0], 70.0);
+    EXPECT_EQUAL(placement.weights()[1], 50.0);
+
+    SECTION("fields outside the inventory go to the lightest server and stay there") {
+        EXPECT_EQUAL(placement.place(field("e", 30)), 1);
+        EXPECT_EQUAL(placement.weights()[1], 80.0);
+
+        EXPECT_EQUAL(placement.place(field("f", 5)), 0);
+        EXPECT_EQUAL(placement.place(field("e", 30)), 1);
+        EXPECT_EQUAL(placement.weights()[1], 80.0);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace multio
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}